@@ -1,6 +1,32 @@
+// Build: g++ -O2 -std=c++17 -pthread VanEmdeBoasTree.cpp -o VanEmdeBoasTree
+
 #include <iostream>
 #include <vector>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <random>
+#include <set>
+#include <map>
+#include <queue>
+#include <string>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <functional>
+#include <cmath>
+#ifdef __linux__ // perf_event_open and mallinfo2 for the benchmark suite, which runs without them elsewhere
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 
 #define NDEBUG
 
@@ -16,50 +42,157 @@ typedef __gnu_pbds::tree<
         __gnu_pbds::tree_order_statistics_node_update>
         ordered_set;
 
+typedef __gnu_pbds::tree<int, int> ordered_map; // same tree with a payload per key
+
 ////////////////////////////////////////////////////////////////////
 
 // My homemade Van Emde Boas tree
-// Handles insertion, deletion, successor of integer keys in O(log log U) time,
-// where all integer keys lie in { 0, 1, 2, ..., U-1 }. O(U) space required.
+// Handles insertion, deletion, successor, predecessor of integer keys in O(log log U) time,
+// where all integer keys lie in { 0, 1, 2, ..., U-1 }. O(U) space required,
+// or space proportional to the populated clusters when built with V::LAZY.
 // Assumes U is a power of 2
 // Status: Stress Tested
 
-#define SMALL (1 << 5)
+#define SMALL (1 << 6) // leaves cover at most 64 keys, one machine word
+
+// Bump allocator owning every node of one tree, so nodes sit contiguously and the
+// whole tree is released at once by destroying the arena (no per-node delete).
+// Nodes freed by a LAZY tree are kept on a free list and reused by later inserts.
+struct Arena {
+    std::vector<char*> chunks;
+    size_t used, capacity;
+    std::vector<void*> freed[32][4]; // freed nodes, by universe bits and flags
+
+    Arena();
+    ~Arena();
+
+    void* allocate(size_t bytes, size_t align);
+
+    template<class T, class... Args>
+    T* make(Args&&... args) { return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...); }
+};
+
+Arena::Arena() : used(0), capacity(0) {}
+
+Arena::~Arena() {
+    for (char* c : chunks) delete[] c;
+}
+
+void* Arena::allocate(size_t bytes, size_t align) {
+    used = (used + align - 1) & ~(align - 1);
+    if (chunks.empty() || used + bytes > capacity) {
+        capacity = std::max(bytes, chunks.empty() ? (size_t) 1 << 16 : std::min(capacity * 2, (size_t) 1 << 26));
+        chunks.push_back(new char[capacity]);
+        used = 0;
+    }
+    void* p = chunks.back() + used;
+    used += bytes;
+    return p;
+}
+
+// std::vector allocator drawing from an Arena, or from the heap when arena == nullptr
+template<class T>
+struct ArenaAllocator {
+    typedef T value_type;
+    Arena* arena;
+
+    explicit ArenaAllocator(Arena* arena = nullptr) : arena(arena) {}
+    template<class S> ArenaAllocator(const ArenaAllocator<S>& o) : arena(o.arena) {}
+
+    T* allocate(size_t n) {
+        return arena ? (T*) arena->allocate(n * sizeof(T), alignof(T)) : std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        if (!arena) std::allocator<T>().deallocate(p, n);
+    }
+
+    template<class S> bool operator==(const ArenaAllocator<S>& o) const { return arena == o.arena; }
+    template<class S> bool operator!=(const ArenaAllocator<S>& o) const { return arena != o.arena; }
+};
+
+struct WorkerPool;
 
 struct V {
+    enum {
+        LAZY = 1, // allocate clusters/summaries on first insert, free them when they go empty
+        RANK = 2 // keep prefix sums of the cluster sizes, needed by rank / select
+    };
+
     int U, B; // universe size, block size
     int min, max;
-    int small; // if U is small ( < 32) use bitmasks
+    int size; // number of keys
+    uint64_t small; // if U is small ( <= 64) use a bitmask
+    int flags;
+    Arena* arena; // owns all nodes when set; the tree is torn down by destroying the arena
 
-    V* summary;
-    std::vector<V*> block;
+    V* summary; // nullptr while no cluster is allocated (LAZY only)
+    std::vector<V*, ArenaAllocator<V*>> block; // block[i] == nullptr means cluster i is empty (LAZY only)
+    std::vector<int, ArenaAllocator<int>> count; // Fenwick tree over block[i]->size (RANK only)
 
-    explicit V(int bits);
+    explicit V(int bits, int flags = 0, Arena* arena = nullptr);
     ~V();
 
     // helper functions
     int index(int i, int j) const;
     int high(int x) const;
     int low(int x) const;
+    V* at(int i) const;
+    V* make(int bits, int flags) const;
+    void destroy(V* v) const;
+    V* cluster(int i);
+    void release(int i);
+    void build(int* keys, size_t n);
+    bool sorted_distinct(const int* keys, size_t n, std::vector<int>& a) const;
+    bool sparse(size_t n) const;
+    void successor_batch_sorted(const int* q, int* out, size_t n) const;
+    uint64_t word() const;
+    void set_word(uint64_t w);
+    void emptied(int i);
+    void reset_max();
+    void clear();
+    void counted(int i, int d);
+    void resized(int i, int before);
+    void recount(const std::vector<int>& clusters);
+    int below(int i) const;
 
-    void insert(int x); // assumes x not in VEB
-    void erase(int x);
+    bool insert(int x); // returns false if x was already in VEB
+    bool erase(int x); // returns false if x was not in VEB
     int successor(int x) const; // returns -1 if x has no successor
+    int predecessor(int x) const; // returns -1 if x has no predecessor
+    int floor(int x) const; // largest key <= x, -1 if there is none
     bool contains(int x) const;
+
+    // bulk load, fastest from sorted keys; duplicates and unsorted keys are accepted (the latter
+    // are sorted first), keys go in with insert if the VEB is not empty. Returns false and leaves
+    // the VEB untouched if a key is outside [0, U).
+    bool build_from_sorted(const int* keys, size_t n);
+    bool build_from_sorted(const int* keys, size_t n, WorkerPool& pool); // same, top-level clusters filled in parallel
+    void successor_batch(const int* xs, int* out, size_t n) const; // out[k] = successor(xs[k])
+
+    bool unite(const V& o); // this = this | o; false if o is over another universe
+    bool intersect(const V& o); // this = this & o, same
+    bool subtract(const V& o); // this = this - o, same
+
+    int rank(int x) const; // number of keys < x, -1 if the VEB was built without RANK
+    int select(int k) const; // k-th smallest key counting from 0, -1 if k >= size or without RANK
 };
 
-V::V(int bits) : U(1 << bits), B(bits >> 1), min(-1), max(-1), small(0), summary(nullptr) {
-    if (U >= SMALL) {
+V::V(int bits, int flags, Arena* arena) : U(1 << bits), B(bits >> 1), min(-1), max(-1), size(0), small(0), flags(flags),
+                                          arena(arena), summary(nullptr), block(ArenaAllocator<V*>(arena)),
+                                          count(ArenaAllocator<int>(arena)) {
+    if (U > SMALL && !(flags & LAZY)) {
 
         int B2 = (bits + 1) >> 1;
         block.resize((1 << B2), nullptr);
-        for (int i = 0; i < (1 << B2); i++) block[i] = new V(B);
+        for (int i = 0; i < (1 << B2); i++) block[i] = make(B, flags);
+        if (flags & RANK) count.assign(1 << B2, 0);
 
-        summary = new V(B2);
+        summary = make(B2, flags & ~RANK);
     }
 }
 
 V::~V() {
+    if (arena) return; // released in bulk by the arena
     delete summary;
     for (V* v : block) delete v;
 }
@@ -68,70 +201,138 @@ int V::index(int i, int j) const { return i << B | j; }
 int V::high(int x) const { return x >> B; }
 int V::low(int x) const { return x & ((1 << B) - 1); }
 
-void V::insert(int x) {
+V* V::at(int i) const { return block.empty() ? nullptr : block[i]; }
+
+// allocates a child node, from the arena if there is one. Clusters share the tree's flags;
+// summaries are made without RANK, as rank / select never look at their counts.
+V* V::make(int bits, int flags) const {
+    if (!arena) return new V(bits, flags);
+
+    std::vector<void*>& freed = arena->freed[bits][flags];
+    if (freed.empty()) return arena->make<V>(bits, flags, arena);
+
+    V* v = (V*) freed.back(); // empty LAZY node, still in its initial state
+    freed.pop_back();
+    return v;
+}
+
+void V::destroy(V* v) const {
+    if (arena) arena->freed[__builtin_ctz(v->U)][v->flags].push_back(v);
+    else delete v;
+}
+
+// returns block[i], allocating it and the summary if needed (LAZY only)
+V* V::cluster(int i) {
+    if (block.empty()) {
+        block.resize(U >> B, nullptr);
+        if (flags & RANK) count.assign(U >> B, 0);
+    }
+    if (summary == nullptr) summary = make(__builtin_ctz(U) - B, flags & ~RANK);
+    if (block[i] == nullptr) block[i] = make(B, flags);
+    return block[i];
+}
+
+// frees the empty cluster i, and the summary once no clusters are left (LAZY only).
+// On an arena the (all nullptr) block and (all zero) count vectors stay with the node, so
+// they are reused along with it from the free list: arena memory is never handed back.
+void V::release(int i) {
+    destroy(block[i]);
+    block[i] = nullptr;
+    if (summary->min == -1) {
+        destroy(summary);
+        summary = nullptr;
+        if (arena) return;
+        decltype(block)(block.get_allocator()).swap(block);
+        decltype(count)(count.get_allocator()).swap(count);
+    }
+}
+
+// Insert and erase find out whether x is present on the way down: nothing is modified
+// until the level that holds x (or would hold it) has been reached, so a duplicate
+// insert or an erase of an absent key returns false and leaves the tree untouched.
+bool V::insert(int x) {
     assert(0 <= x && x < U);
 
     if (min == -1) {
         min = max = x;
-        return;
+        size = 1;
+        return true;
     }
 
-    if (x < min) std::swap(x, min);
-    if (x > max) max = x;
+    if (x == min) return false;
+    if (x < min) std::swap(x, min); // the old min is not in the clusters, so this insert succeeds
 
-    if (U < SMALL) {
-        small |= 1<<x;
-        return;
+    if (U <= SMALL) {
+        if (small >> x & 1) return false;
+        small |= 1ULL << x;
+    } else {
+        int i = high(x), j = low(x);
+        if (flags & LAZY) cluster(i);
+        if (block[i]->min == -1) {
+            summary->insert(i);
+            block[i]->insert(j);
+        } else if (!block[i]->insert(j)) {
+            return false;
+        }
+        counted(i, 1);
     }
 
-    int i = high(x), j = low(x);
-    if (block[i]->min == -1)
-        summary->insert(i);
-
-    block[i]->insert(j);
+    if (x > max) max = x;
+    size++;
+    return true;
 }
 
-void V::erase(int x) {
+bool V::erase(int x) {
     assert(0 <= x && x < U);
 
-    if (U < SMALL) {
-        if (x == min) min = -1;
-        if (x == max) max = min;
-
-        small &= ~(1 << x);
+    if (x < min || x > max) return false; // also covers the empty tree
 
-        for (int i = 0; i < U; i++) {
-            if (small >> i & 1) {
-                if (min == -1) {
-                    min = i;
-                    small &= ~(1 << i);
-                }
-                max = i;
+    if (U <= SMALL) {
+        if (x == min) {
+            if (small == 0) { // deleting last element
+                min = max = -1;
+                size = 0;
+                return true;
             }
+            min = __builtin_ctzll(small); // min is not kept in the bitmask
+            small &= small - 1;
+        } else {
+            if (!(small >> x & 1)) return false;
+            small &= ~(1ULL << x);
         }
-        return;
+        max = small ? 63 - __builtin_clzll(small) : min;
+        size--;
+        return true;
     }
 
     if (x == min) {
-        int i = summary->min;
+        int i = summary == nullptr ? -1 : summary->min;
         if (i == -1) { // deleting last element
             min = max = -1;
-            return;
+            size = 0;
+            return true;
         }
         x = min = index(i, block[i]->min); // next smallest element
     }
 
-    block[high(x)]->erase(low(x));
-    if (block[high(x)]->min == -1)
+    V* c = at(high(x));
+    if (c == nullptr || !c->erase(low(x))) return false; // x not in VEB
+
+    size--;
+    counted(high(x), -1);
+    if (c->min == -1) {
         summary->erase(high(x));
+        if (flags & LAZY) release(high(x));
+    }
 
     if (x == max) {
-        int i = summary->max;
+        int i = summary == nullptr ? -1 : summary->max;
         if (i == -1)
             max = min;
         else
             max = index(i, block[i]->max);
     }
+    return true;
 }
 
 int V::successor(int x) const {
@@ -139,18 +340,18 @@ int V::successor(int x) const {
 
     if (x < min) return min;
 
-    if (U < SMALL) {
-        for (int i = x+1; i < U; i++)
-            if (small >> i & 1) return i;
-        return -1;
+    if (U <= SMALL) {
+        uint64_t above = x == 63 ? 0 : small & (~0ULL << (x + 1));
+        return above ? __builtin_ctzll(above) : -1;
     }
 
     int i = high(x), j = low(x);
+    const V* c = at(i);
 
-    if (j < block[i]->max) {
-        j = block[i]->successor(j);
+    if (c != nullptr && j < c->max) {
+        j = c->successor(j);
     } else {
-        i = summary->successor(i);
+        i = summary == nullptr ? -1 : summary->successor(i);
         if (i != -1) {
             j = block[i]->min;
             assert(j != -1);
@@ -160,131 +361,4883 @@ int V::successor(int x) const {
     return index(i, j);
 }
 
-bool V::contains(int x) const {
-    return x == min || (U < SMALL ? small >> x & 1 : block[high(x)]->contains(low(x)));
+int V::predecessor(int x) const {
+    assert(0 <= x && x < U);
+    return x == 0 ? -1 : floor(x - 1);
 }
 
-////////////////////////////////////////////////////////////////////
+// x itself is found where it is stored, as a min or as a leaf bit, in the same descent,
+// so "largest key <= x" does not need a contains(x) first
+int V::floor(int x) const {
+    assert(0 <= x && x < U);
 
-int getSuccessor(const std::vector<int>& a, int x) {
-    for (int i = x+1; i < (int) a.size(); i++) {
-        if (a[i] != 0) {
-            return i;
-        }
+    if (x >= max) return max; // also covers the empty tree
+    if (x <= min) return x == min ? min : -1;
+
+    if (U <= SMALL) {
+        uint64_t below = small & ((2ULL << x) - 1); // x < max <= 63
+        return below ? 63 - __builtin_clzll(below) : min;
     }
-    return -1;
+
+    int i = high(x), j = low(x);
+    const V* c = at(i);
+
+    if (c != nullptr && c->min != -1 && j >= c->min) {
+        j = c->floor(j);
+    } else {
+        i = summary == nullptr ? -1 : summary->predecessor(i);
+        if (i == -1) return min;
+        j = block[i]->max;
+    }
+
+    return index(i, j);
 }
 
-// uses a direct access table to check the correctness of the VEB
-// direct access table uses a linear scan to find successor
-bool check_correctness(int U, int numInserted) {
+bool V::contains(int x) const {
+    if (x == min) return true;
+    if (U <= SMALL) return small >> x & 1;
 
-    int bits = 0;
-    while ((1 << bits) < U) ++bits;
-    V* VEB = new V(bits);
-    std::vector<int> table(U);
+    const V* c = at(high(x));
+    return c != nullptr && c->contains(low(x));
+}
 
-    std::vector<int> inserted(numInserted);
-    for (int i = 0; i < numInserted; i++) {
-        inserted[i] = rand() % U;
-        if (!VEB->contains(inserted[i]))
-            VEB->insert(inserted[i]);
-        else assert(table[inserted[i]] == 1);
-        table[inserted[i]] = 1;
+// Bulk load: instead of one root-to-leaf descent per key, every node is filled exactly
+// once. A node takes its min and max, splits the remaining keys into runs by cluster,
+// builds each cluster from its run and then the summary from the list of clusters used.
+// Each level is one sequential pass over its keys.
+bool V::build_from_sorted(const int* keys, size_t n) {
+    std::vector<int> a;
+    if (!sorted_distinct(keys, n, a)) return false;
+
+    if (min != -1) {
+        for (int x : a) insert(x);
+    } else if (!a.empty()) {
+        build(a.data(), a.size());
+    }
+    return true;
+}
+
+// a = the distinct keys in increasing order; false if a key is outside [0, U)
+bool V::sorted_distinct(const int* keys, size_t n, std::vector<int>& a) const {
+    bool sorted = true;
+    a.reserve(n);
+    for (size_t k = 0; k < n; k++) {
+        if (keys[k] < 0 || keys[k] >= U) return false;
+        if (!a.empty() && a.back() > keys[k]) sorted = false;
+        if (a.empty() || a.back() != keys[k]) a.push_back(keys[k]);
     }
+    if (!sorted) {
+        std::sort(a.begin(), a.end());
+        a.erase(std::unique(a.begin(), a.end()), a.end());
+    }
+    return true;
+}
 
-    for (int round = 0; round < 10; round++) {
-        for (int x = 0; x < U; x++) {
-            // check successor of each element is correct
-            if (VEB->successor(x) != getSuccessor(table, x)) {
-                return false;
+// Batched successor: the sorted batch goes down the tree together, split by cluster.
+// Each cluster is entered once for all queries it can answer, and all queries past its
+// max share a single summary lookup, so whole subtrees are skipped instead of being
+// re-walked from the root per query. A query below the previous answer has that answer
+// too and needs no descent at all. Where the batch is sparse, about one query per
+// populated cluster, there is nothing to share and it is answered query by query.
+// Unsorted batches are answered query by query too: sorting them first only paid off for
+// batches of millions of queries on trees far larger than the cache, and lost up to 5x
+// on trees that fit in it.
+void V::successor_batch(const int* xs, int* out, size_t n) const {
+    if (std::is_sorted(xs, xs + n)) successor_batch_sorted(xs, out, n);
+    else for (size_t k = 0; k < n; k++) out[k] = successor(xs[k]);
+}
+
+// true if n queries are too few to share clusters
+bool V::sparse(size_t n) const {
+    return U <= SMALL || summary == nullptr || n <= (size_t) summary->size;
+}
+
+// q is sorted, and this node reads q[k] & (U - 1), the low part its parent would have
+// passed down, so the batch is never copied. Answers are written out whole: one inside this
+// node shares the high bits above it with its query, so no level has to map them back.
+void V::successor_batch_sorted(const int* q, int* out, size_t n) const {
+    int mask = U - 1, hi = q[0] & ~mask;
+
+    if (sparse(n)) {
+        for (size_t k = 0; k < n; k++) {
+            if (k > 0 && (out[k - 1] == -1 || q[k] < out[k - 1])) {
+                out[k] = out[k - 1];
+            } else {
+                int y = successor(q[k] & mask);
+                out[k] = y == -1 ? -1 : hi | y;
             }
         }
+        return;
+    }
 
-        // remove some random elements
-        for (int i = 0; i < 20 && !inserted.empty(); i++) {
-            int n = inserted.size();
+    size_t k = 0;
+    for (; k < n && (q[k] & mask) < min; k++) out[k] = hi | min;
 
-            std::swap(inserted[rand() % n], inserted.back());
-            int x = inserted.back();
-            inserted.pop_back();
+    while (k < n) {
+        int i = high(q[k] & mask);
+        const V* c = at(i);
 
-            table[x] = 0;
-            VEB->erase(x);
+        // queries answered inside cluster i
+        size_t e = k;
+        if (c != nullptr)
+            for (; e < n && high(q[e] & mask) == i && low(q[e]) < c->max; e++);
+        if (e > k) {
+            c->successor_batch_sorted(q + k, out + k, e - k);
+            k = e;
+        }
+
+        // the rest of cluster i, and every later query below the answer, get the min of the
+        // next non-empty cluster
+        if (k < n && high(q[k] & mask) == i) {
+            int next = summary->successor(i);
+            int ans = next == -1 ? -1 : hi | index(next, block[next]->min);
+            for (; k < n && (ans == -1 || q[k] < ans); k++) out[k] = ans;
         }
     }
+}
 
-    std::cout << "All tests passed!" << std::endl;
-    delete VEB;
+// keys are sorted and distinct, and are overwritten with their low parts on the way down
+void V::build(int* keys, size_t n) {
+    min = keys[0];
+    max = keys[n - 1];
+    size = n;
+
+    if (U <= SMALL) {
+        for (size_t k = 1; k < n; k++) small |= 1ULL << keys[k];
+        return;
+    }
+
+    std::vector<int> clusters;
+    for (size_t k = 1, e; k < n; k = e) {
+        int i = high(keys[k]);
+        for (e = k; e < n && high(keys[e]) == i; e++) keys[e] = low(keys[e]);
+
+        V* c = flags & LAZY ? cluster(i) : block[i];
+        c->build(keys + k, e - k);
+        clusters.push_back(i);
+    }
+
+    recount(clusters); // before the summary build overwrites the cluster numbers
+    if (!clusters.empty()) summary->build(clusters.data(), clusters.size());
+}
+
+// leaf contents as one word, min included
+uint64_t V::word() const {
+    return min == -1 ? small : small | 1ULL << min;
+}
+
+void V::set_word(uint64_t w) {
+    size = __builtin_popcountll(w);
+    if (w == 0) {
+        min = max = -1;
+        small = 0;
+        return;
+    }
+    min = __builtin_ctzll(w);
+    max = 63 - __builtin_clzll(w);
+    small = w & (w - 1);
+}
+
+// cluster i gained d keys
+void V::counted(int i, int d) {
+    if (!(flags & RANK)) return;
+    for (int n = count.size(), k = i + 1; k <= n; k += k & -k) count[k - 1] += d;
+}
+
+// cluster i changed size, it had `before` keys
+void V::resized(int i, int before) {
+    int d = block[i]->size - before;
+    size += d;
+    counted(i, d);
+}
+
+// sets up the Fenwick tree from the sizes of the (sorted) non-empty clusters, in O(U / 2^B)
+void V::recount(const std::vector<int>& clusters) {
+    if (!(flags & RANK) || count.empty()) return;
+    for (int i : clusters) count[i] = block[i]->size;
+    for (int n = count.size(), k = 1; k <= n; k++)
+        if (k + (k & -k) <= n)
+            count[k + (k & -k) - 1] += count[k - 1];
+}
+
+// number of keys in clusters 0..i-1
+int V::below(int i) const {
+    int s = 0;
+    for (int k = count.empty() ? 0 : i; k > 0; k -= k & -k) s += count[k - 1];
+    return s;
+}
+
+// cluster i has just become empty
+void V::emptied(int i) {
+    summary->erase(i);
+    if (flags & LAZY) release(i);
+}
+
+// max after the clusters changed underneath it
+void V::reset_max() {
+    int i = summary == nullptr ? -1 : summary->max;
+    max = i == -1 ? min : index(i, block[i]->max);
+}
+
+void V::clear() {
+    if (U <= SMALL) {
+        set_word(0);
+        return;
+    }
+    for (int i = summary == nullptr ? -1 : summary->min; i != -1; i = summary == nullptr ? -1 : summary->successor(i)) {
+        int before = block[i]->size;
+        block[i]->clear();
+        resized(i, before);
+        emptied(i);
+    }
+    min = max = -1;
+    size = 0;
+}
+
+// Set operations, in place. Both trees are walked together cluster by cluster: unite only
+// visits the clusters populated in o, subtract only those populated in both (leapfrogging
+// between the two summaries), and intersect those populated in this, dropping whole clusters
+// that are empty in o without descending into them. Leaves are combined as one AND / OR.
+// The two mins are not kept in the clusters and are fixed up with one insert or erase each.
+// Each returns false, leaving this untouched, when o is over a different universe.
+bool V::unite(const V& o) {
+    if (U != o.U) return false;
+
+    if (o.min == -1) return true;
+
+    if (U <= SMALL) {
+        set_word(word() | o.word());
+        return true;
+    }
+
+    for (int i = o.summary == nullptr ? -1 : o.summary->min; i != -1; i = o.summary->successor(i)) {
+        V* c = flags & LAZY ? cluster(i) : block[i];
+        if (c->min == -1) summary->insert(i);
+        int before = c->size;
+        c->unite(*o.block[i]);
+        resized(i, before);
+    }
+
+    if (min == -1) { // the clusters now hold o minus its min
+        min = o.min;
+        size++;
+        reset_max();
+        return true;
+    }
+
+    V* c = at(high(min));
+    if (c != nullptr && c->erase(low(min))) { // min came in again from o's clusters
+        size--;
+        counted(high(min), -1);
+        if (c->min == -1) emptied(high(min));
+    }
+    reset_max();
+
+    insert(o.min);
     return true;
 }
 
+bool V::intersect(const V& o) {
+    if (U != o.U) return false;
 
-long long check_performance_BST(int U, int insertions, int erases, int successors) {
-    long long ans = 0;
+    if (min == -1) return true;
 
-    ordered_set s;
+    if (U <= SMALL) {
+        set_word(word() & o.word());
+        return true;
+    }
 
-    for (int i = 0; i < insertions; i++) {
-        int x = rand() % (U - 1) + 1;
-        s.insert(x);
+    bool keepMin = o.contains(min);
+    bool addMin = o.min != -1 && o.min != min && contains(o.min); // o's min is not in o's clusters
+
+    for (int i = summary == nullptr ? -1 : summary->min; i != -1; i = summary == nullptr ? -1 : summary->successor(i)) {
+        const V* c = o.at(i);
+        int before = block[i]->size;
+        if (c != nullptr && c->min != -1) block[i]->intersect(*c);
+        else block[i]->clear();
+        resized(i, before);
+        if (block[i]->min == -1) emptied(i);
     }
+    reset_max();
 
-    for (int i = 0; i < erases; i++) {
-        s.erase(rand() % U);
+    if (addMin) insert(o.min);
+    if (!keepMin) erase(min);
+    return true;
+}
+
+bool V::subtract(const V& o) {
+    if (U != o.U) return false;
+
+    if (min == -1 || o.min == -1) return true;
+
+    if (U <= SMALL) {
+        set_word(word() & ~o.word());
+        return true;
     }
 
-    for (int i = 0; i < successors; i++) {
-        int ord = s.order_of_key(rand() % U);
-        if (ord < (int) s.size() - 1) {
-            ans += *s.find_by_order(ord + 1); // next biggest element
-        } else {
-            ans += -1;
+    bool keepMin = !o.contains(min);
+    if (o.min != min) erase(o.min); // o's min is not in o's clusters
+
+    const V* s = summary;
+    const V* t = o.summary;
+    int i = s == nullptr || t == nullptr ? -1 : s->min;
+    while (i != -1) {
+        if (!t->contains(i)) { // skip to the next cluster populated in o, then in this
+            i = t->successor(i);
+            if (i != -1 && !s->contains(i)) i = s->successor(i);
+            continue;
+        }
+        int next = s->successor(i);
+        int before = block[i]->size;
+        block[i]->subtract(*o.block[i]);
+        resized(i, before);
+        if (block[i]->min == -1) {
+            emptied(i);
+            s = summary;
+            if (s == nullptr) break;
         }
+        i = next;
     }
+    reset_max();
 
-    std::cout << "All tests passed!" << std::endl;
-    return ans;
+    if (!keepMin) erase(min);
+    return true;
 }
 
-long long check_performance_VEB(int U, int insertions, int erases, int successors) {
-    long long ans = 0;
+// new trees holding a | b, a & b and a - b, nullptr when a and b differ in universe
+V* unite(const V& a, const V& b, int flags = 0) {
+    if (a.U != b.U) return nullptr;
+    V* v = new V(__builtin_ctz(a.U), flags);
+    v->unite(a);
+    v->unite(b);
+    return v;
+}
 
-    int bits = 0;
-    while ((1 << bits) < U) ++bits;
-    V* VEB = new V(bits);
+V* intersect(const V& a, const V& b, int flags = 0) {
+    if (a.U != b.U) return nullptr;
+    V* v = new V(__builtin_ctz(a.U), flags);
+    v->unite(a);
+    v->intersect(b);
+    return v;
+}
 
-    for (int i = 0; i < insertions; i++) {
-        int x = rand() % U;
-        if (!VEB->contains(x))
-            VEB->insert(x);
+V* subtract(const V& a, const V& b, int flags = 0) {
+    if (a.U != b.U) return nullptr;
+    V* v = new V(__builtin_ctz(a.U), flags);
+    v->unite(a);
+    v->subtract(b);
+    return v;
+}
+
+// Order statistics. Every node knows its size, and with RANK a Fenwick tree over the sizes
+// of its clusters, so rank adds up the clusters left of x and select searches for the
+// cluster holding the k-th key, each in O(log 2^B) per level. That makes both O(log U)
+// overall, and insert / erase pay the same O(log U) to keep the counts current.
+int V::rank(int x) const {
+    assert(0 <= x && x < U);
+
+    if (!(flags & RANK)) return -1;
+    if (min == -1 || x <= min) return 0;
+    if (U <= SMALL) return 1 + __builtin_popcountll(small & ((1ULL << x) - 1));
+
+    const V* c = at(high(x));
+    return 1 + below(high(x)) + (c == nullptr ? 0 : c->rank(low(x)));
+}
+
+int V::select(int k) const {
+    if (!(flags & RANK) || k < 0 || k >= size) return -1;
+    if (k-- == 0) return min;
+
+    if (U <= SMALL) { // position of the k-th set bit, halving the word
+        uint64_t w = small;
+        int x = 0;
+        for (int width = 32; width > 0; width >>= 1) {
+            int c = __builtin_popcountll(w & ((1ULL << width) - 1));
+            if (k >= c) {
+                k -= c;
+                w >>= width;
+                x += width;
+            }
+        }
+        return x;
     }
 
-    for (int i = 0; i < erases; i++) {
-        VEB->erase(rand() % U);
+    // Fenwick descent to the cluster holding the k-th key
+    int i = 0;
+    for (int n = count.size(), step = n; step > 0; step >>= 1) {
+        if (i + step <= n && count[i + step - 1] <= k) {
+            i += step;
+            k -= count[i - 1];
+        }
     }
+    return index(i, block[i]->select(k));
+}
 
-    for (int i = 0; i < successors; i++) {
-        ans += VEB->successor(rand() % U);
+////////////////////////////////////////////////////////////////////
+
+// Software-pipelined successor queries on V.
+// A single descent is a chain of dependent loads (node, block[i], cluster, summary ...),
+// each one a likely cache miss. Here G queries are in flight at once, each an explicit
+// state machine that stops right after prefetching the next memory it needs; the
+// pipeline then moves on to the other queries while that miss resolves.
+
+struct SuccessorPipeline {
+    enum Stage { VISIT, CHILD, CHECK, SUMMARY, UNWIND, MIN_PTR, MIN };
+
+    struct Frame {
+        const V* parent;
+        int i;
+        bool summary; // descended into parent's summary (true) or into block[i] (false)
+    };
+
+    struct Query {
+        Stage stage;
+        size_t slot; // position in the input batch
+        const V* node; // node being visited
+        const V* child;
+        int x, i, j, result;
+        int depth;
+        Frame frame[16];
+    };
+
+    const V* root;
+    int G; // queries in flight
+    long long loads; // prefetched dependent loads, i.e. potential misses
+
+    SuccessorPipeline(const V* root, int G);
+
+    void run(const int* xs, int* out, size_t n); // out[k] = root->successor(xs[k])
+    void start(Query& q, size_t slot, int x);
+    bool step(Query& q); // advances q up to its next prefetch, true once it has an answer
+};
+
+SuccessorPipeline::SuccessorPipeline(const V* root, int G) : root(root), G(G), loads(0) {}
+
+void SuccessorPipeline::run(const int* xs, int* out, size_t n) {
+    std::vector<Query> q(G);
+    std::vector<bool> live(G, false);
+    size_t next = 0;
+    int active = 0;
+
+    for (int g = 0; g < G && next < n; g++, next++) {
+        start(q[g], next, xs[next]);
+        live[g] = true;
+        active++;
     }
 
-    std::cout << "All tests passed!" << std::endl;
-    delete VEB;
-    return ans;
+    while (active > 0) {
+        for (int g = 0; g < G; g++) {
+            if (!live[g] || !step(q[g])) continue;
+
+            out[q[g].slot] = q[g].result;
+            if (next < n) {
+                start(q[g], next, xs[next]);
+                next++;
+            } else {
+                live[g] = false;
+                active--;
+            }
+        }
+    }
 }
 
-int main(int argc, char* argv[]) {
-    srand(time(nullptr));
-//    for (int i = 0; i < 100; i++) {
-//        std::cout << "Test #" << i << std::endl;
-//        if (!check_correctness(5000, rand() % 1000)) {
-//            std::cout << "Failed Test :(" << std::endl;
-//            return 1;
-//        }
-//    }
+void SuccessorPipeline::start(Query& q, size_t slot, int x) {
+    q.stage = VISIT;
+    q.slot = slot;
+    q.node = root;
+    q.x = x;
+    q.depth = 0;
+    __builtin_prefetch(root);
+    loads++;
+}
 
-//    std::cout << check_performance_BST(5e7, 1e7, 1e7, 1e7) << std::endl; // approx. 60 seconds on my laptop
-    std::cout << check_performance_VEB(5e7, 1e7, 1e7, 1e7) << std::endl; // approx. 13 seconds on my laptop
-        
-    return 0;
+bool SuccessorPipeline::step(Query& q) {
+    for (;;) {
+        switch (q.stage) {
+        case VISIT: {
+            const V* v = q.node;
+            if (q.x < v->min) {
+                q.result = v->min;
+                q.stage = UNWIND;
+            } else if (v->U <= SMALL) {
+                q.result = v->successor(q.x);
+                q.stage = UNWIND;
+            } else if (v->block.empty()) {
+                q.stage = SUMMARY;
+            } else {
+                q.i = v->high(q.x);
+                q.j = v->low(q.x);
+                __builtin_prefetch(&v->block[q.i]);
+                loads++;
+                q.stage = CHILD;
+                return false;
+            }
+            break;
+        }
+
+        case CHILD:
+            q.child = q.node->block[q.i];
+            if (q.child == nullptr) {
+                q.stage = SUMMARY;
+                break;
+            }
+            __builtin_prefetch(q.child);
+            loads++;
+            q.stage = CHECK;
+            return false;
+
+        case CHECK:
+            if (q.j < q.child->max) { // answer is inside block[i], which is already cached
+                q.frame[q.depth++] = Frame{q.node, q.i, false};
+                q.node = q.child;
+                q.x = q.j;
+                q.stage = VISIT;
+            } else {
+                q.stage = SUMMARY;
+            }
+            break;
+
+        case SUMMARY:
+            if (q.node->summary == nullptr) {
+                q.result = -1;
+                q.stage = UNWIND;
+                break;
+            }
+            q.frame[q.depth++] = Frame{q.node, q.i, true};
+            q.x = q.i;
+            q.node = q.node->summary;
+            __builtin_prefetch(q.node);
+            loads++;
+            q.stage = VISIT;
+            return false;
+
+        case UNWIND: {
+            if (q.depth == 0) return true;
+
+            const Frame& f = q.frame[q.depth - 1];
+            if (q.result == -1) {
+                q.depth--;
+            } else if (!f.summary) {
+                q.result = f.parent->index(f.i, q.result);
+                q.depth--;
+            } else { // result is the next non-empty cluster, its min is the answer
+                __builtin_prefetch(&f.parent->block[q.result]);
+                loads++;
+                q.stage = MIN_PTR;
+                return false;
+            }
+            break;
+        }
+
+        case MIN_PTR:
+            q.child = q.frame[q.depth - 1].parent->block[q.result];
+            __builtin_prefetch(q.child);
+            loads++;
+            q.stage = MIN;
+            return false;
+
+        case MIN:
+            q.result = q.frame[q.depth - 1].parent->index(q.result, q.child->min);
+            q.depth--;
+            q.stage = UNWIND;
+            break;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Pointer-free Van Emde Boas tree, same recursion as V but every node lives in one
+// preallocated array. A subtree over b bits is laid out as its root, then its summary,
+// then its 2^(b - b/2) clusters back to back, so the position of a child is computed
+// from b and the cluster index instead of being loaded from a pointer.
+// O(U) space, 16 bytes per node.
+
+struct FlatV {
+    struct Node {
+        int min, max;
+        uint64_t small; // bitmask of a leaf ( U <= 64 )
+    };
+
+    int bits;
+    std::vector<int> size; // size[b] = number of nodes in a subtree over b bits
+    std::vector<Node> nodes;
+
+    explicit FlatV(int bits);
+
+    // helper functions, p is the position of a subtree over b bits
+    int summary(int p) const;
+    int cluster(int p, int b, int i) const;
+
+    void insert(int x); // assumes x not in VEB
+    void erase(int x);
+    int successor(int x) const; // returns -1 if x has no successor
+    int predecessor(int x) const; // returns -1 if x has no predecessor
+    int floor(int x) const; // largest key <= x, -1 if there is none
+    bool contains(int x) const;
+
+    void insert(int p, int b, int x);
+    void erase(int p, int b, int x);
+    int successor(int p, int b, int x) const;
+    int floor(int p, int b, int x) const;
+    bool contains(int p, int b, int x) const;
+};
+
+FlatV::FlatV(int bits) : bits(bits), size(bits + 1) {
+    for (int b = 0; b <= bits; b++) {
+        if ((1 << b) <= SMALL) size[b] = 1;
+        else size[b] = 1 + size[b - (b >> 1)] + (1 << (b - (b >> 1))) * size[b >> 1];
+    }
+    nodes.assign(size[bits], Node{-1, -1, 0});
+}
+
+int FlatV::summary(int p) const { return p + 1; }
+int FlatV::cluster(int p, int b, int i) const { return p + 1 + size[b - (b >> 1)] + i * size[b >> 1]; }
+
+void FlatV::insert(int x) { insert(0, bits, x); }
+void FlatV::erase(int x) { erase(0, bits, x); }
+int FlatV::successor(int x) const { return successor(0, bits, x); }
+int FlatV::predecessor(int x) const { return x == 0 ? -1 : floor(0, bits, x - 1); }
+int FlatV::floor(int x) const { return floor(0, bits, x); }
+bool FlatV::contains(int x) const { return contains(0, bits, x); }
+
+void FlatV::insert(int p, int b, int x) {
+    assert(0 <= x && x < (1 << b));
+    Node& v = nodes[p];
+
+    if (v.min == -1) {
+        v.min = v.max = x;
+        return;
+    }
+
+    if (x < v.min) std::swap(x, v.min);
+    if (x > v.max) v.max = x;
+
+    if ((1 << b) <= SMALL) {
+        v.small |= 1ULL << x;
+        return;
+    }
+
+    int B = b >> 1, i = x >> B, j = x & ((1 << B) - 1);
+    int c = cluster(p, b, i);
+    if (nodes[c].min == -1)
+        insert(summary(p), b - B, i);
+
+    insert(c, B, j);
+}
+
+void FlatV::erase(int p, int b, int x) {
+    assert(0 <= x && x < (1 << b));
+    Node& v = nodes[p];
+
+    if ((1 << b) <= SMALL) {
+        if (x == v.min) {
+            if (v.small == 0) { // deleting last element
+                v.min = v.max = -1;
+                return;
+            }
+            v.min = __builtin_ctzll(v.small); // min is not kept in the bitmask
+            v.small &= v.small - 1;
+        } else {
+            v.small &= ~(1ULL << x);
+        }
+        v.max = v.small ? 63 - __builtin_clzll(v.small) : v.min;
+        return;
+    }
+
+    int B = b >> 1, s = summary(p);
+
+    if (x == v.min) {
+        int i = nodes[s].min;
+        if (i == -1) { // deleting last element
+            v.min = v.max = -1;
+            return;
+        }
+        x = v.min = i << B | nodes[cluster(p, b, i)].min; // next smallest element
+    }
+
+    int c = cluster(p, b, x >> B);
+    erase(c, B, x & ((1 << B) - 1));
+    if (nodes[c].min == -1)
+        erase(s, b - B, x >> B);
+
+    if (x == v.max) {
+        int i = nodes[s].max;
+        if (i == -1)
+            v.max = v.min;
+        else
+            v.max = i << B | nodes[cluster(p, b, i)].max;
+    }
+}
+
+int FlatV::successor(int p, int b, int x) const {
+    assert(0 <= x && x < (1 << b));
+    const Node& v = nodes[p];
+
+    if (x < v.min) return v.min;
+
+    if ((1 << b) <= SMALL) {
+        uint64_t above = x == 63 ? 0 : v.small & (~0ULL << (x + 1));
+        return above ? __builtin_ctzll(above) : -1;
+    }
+
+    int B = b >> 1, i = x >> B, j = x & ((1 << B) - 1);
+    int c = cluster(p, b, i);
+
+    if (j < nodes[c].max) {
+        j = successor(c, B, j);
+    } else {
+        i = successor(summary(p), b - B, i);
+        if (i != -1) {
+            j = nodes[cluster(p, b, i)].min;
+            assert(j != -1);
+        } else return -1;
+    }
+
+    return i << B | j;
+}
+
+int FlatV::floor(int p, int b, int x) const {
+    assert(0 <= x && x < (1 << b));
+    const Node& v = nodes[p];
+
+    if (x >= v.max) return v.max; // also covers the empty subtree
+    if (x <= v.min) return x == v.min ? v.min : -1;
+
+    if ((1 << b) <= SMALL) {
+        uint64_t below = v.small & ((2ULL << x) - 1); // x < max <= 63
+        return below ? 63 - __builtin_clzll(below) : v.min;
+    }
+
+    int B = b >> 1, i = x >> B, j = x & ((1 << B) - 1);
+    int c = cluster(p, b, i);
+
+    if (nodes[c].min != -1 && j >= nodes[c].min) {
+        j = floor(c, B, j);
+    } else {
+        i = i == 0 ? -1 : floor(summary(p), b - B, i - 1);
+        if (i == -1) return v.min;
+        j = nodes[cluster(p, b, i)].max;
+    }
+
+    return i << B | j;
+}
+
+bool FlatV::contains(int p, int b, int x) const {
+    const Node& v = nodes[p];
+    if (x == v.min) return true;
+    if ((1 << b) <= SMALL) return v.small >> x & 1;
+
+    int B = b >> 1;
+    return contains(cluster(p, b, x >> B), B, x & ((1 << B) - 1));
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Van Emde Boas tree with the universe fixed at compile time, U = 2^Bits.
+// There are no runtime U/B fields: high/low/index are constexpr shifts and masks, the
+// summary and clusters are VEB<(Bits+1)/2> and VEB<Bits/2> stored by value, and the
+// leaf case is picked with if constexpr, so the whole recursion chain can be inlined.
+// A VEB<Bits> is one contiguous O(U) object, allocate large ones with new.
+
+template<int Bits> struct VEB;
+
+// children of an internal node
+template<int Bits, bool Leaf>
+struct VEBStorage {
+    VEB<Bits - (Bits >> 1)> summary;
+    VEB<(Bits >> 1)> block[1 << (Bits - (Bits >> 1))];
+};
+
+// a leaf keeps its keys (except min) in one word
+template<int Bits>
+struct VEBStorage<Bits, true> {
+    uint64_t small = 0;
+};
+
+template<int Bits>
+struct VEB : VEBStorage<Bits, (1 << Bits) <= SMALL> {
+    static constexpr int U = 1 << Bits, B = Bits >> 1;
+    static constexpr bool leaf = U <= SMALL;
+
+    int min = -1, max = -1;
+
+    // helper functions
+    static constexpr int index(int i, int j) { return i << B | j; }
+    static constexpr int high(int x) { return x >> B; }
+    static constexpr int low(int x) { return x & ((1 << B) - 1); }
+
+    void insert(int x); // assumes x not in VEB
+    void erase(int x);
+    int successor(int x) const; // returns -1 if x has no successor
+    int predecessor(int x) const; // returns -1 if x has no predecessor
+    int floor(int x) const; // largest key <= x, -1 if there is none
+    bool contains(int x) const;
+};
+
+template<int Bits>
+void VEB<Bits>::insert(int x) {
+    assert(0 <= x && x < U);
+
+    if (min == -1) {
+        min = max = x;
+        return;
+    }
+
+    if (x < min) std::swap(x, min);
+    if (x > max) max = x;
+
+    if constexpr (leaf) {
+        this->small |= 1ULL << x;
+    } else {
+        int i = high(x), j = low(x);
+        if (this->block[i].min == -1)
+            this->summary.insert(i);
+
+        this->block[i].insert(j);
+    }
+}
+
+template<int Bits>
+void VEB<Bits>::erase(int x) {
+    assert(0 <= x && x < U);
+
+    if constexpr (leaf) {
+        if (x == min) {
+            if (this->small == 0) { // deleting last element
+                min = max = -1;
+                return;
+            }
+            min = __builtin_ctzll(this->small); // min is not kept in the bitmask
+            this->small &= this->small - 1;
+        } else {
+            this->small &= ~(1ULL << x);
+        }
+        max = this->small ? 63 - __builtin_clzll(this->small) : min;
+    } else {
+        if (x == min) {
+            int i = this->summary.min;
+            if (i == -1) { // deleting last element
+                min = max = -1;
+                return;
+            }
+            x = min = index(i, this->block[i].min); // next smallest element
+        }
+
+        this->block[high(x)].erase(low(x));
+        if (this->block[high(x)].min == -1)
+            this->summary.erase(high(x));
+
+        if (x == max) {
+            int i = this->summary.max;
+            if (i == -1)
+                max = min;
+            else
+                max = index(i, this->block[i].max);
+        }
+    }
+}
+
+template<int Bits>
+int VEB<Bits>::successor(int x) const {
+    assert(0 <= x && x < U);
+
+    if (x < min) return min;
+
+    if constexpr (leaf) {
+        uint64_t above = x == 63 ? 0 : this->small & (~0ULL << (x + 1));
+        return above ? __builtin_ctzll(above) : -1;
+    } else {
+        int i = high(x), j = low(x);
+
+        if (j < this->block[i].max) {
+            j = this->block[i].successor(j);
+        } else {
+            i = this->summary.successor(i);
+            if (i != -1) {
+                j = this->block[i].min;
+                assert(j != -1);
+            } else return -1;
+        }
+
+        return index(i, j);
+    }
+}
+
+template<int Bits>
+int VEB<Bits>::predecessor(int x) const {
+    assert(0 <= x && x < U);
+    return x == 0 ? -1 : floor(x - 1);
+}
+
+template<int Bits>
+int VEB<Bits>::floor(int x) const {
+    assert(0 <= x && x < U);
+
+    if (x >= max) return max; // also covers the empty tree
+    if (x <= min) return x == min ? min : -1;
+
+    if constexpr (leaf) {
+        uint64_t below = this->small & ((2ULL << x) - 1); // x < max <= 63
+        return below ? 63 - __builtin_clzll(below) : min;
+    } else {
+        int i = high(x), j = low(x);
+
+        if (this->block[i].min != -1 && j >= this->block[i].min) {
+            j = this->block[i].floor(j);
+        } else {
+            i = this->summary.predecessor(i);
+            if (i == -1) return min;
+            j = this->block[i].max;
+        }
+
+        return index(i, j);
+    }
+}
+
+template<int Bits>
+bool VEB<Bits>::contains(int x) const {
+    if (x == min) return true;
+    if constexpr (leaf) return this->small >> x & 1;
+    else return this->block[high(x)].contains(low(x));
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Van Emde Boas tree over 64-bit keys, U = 2^bits with bits up to 64.
+// Clusters are kept in a hash table and only exist while non-empty, so space is
+// O(n log log U) in the worst case and there is no O(U) term. Hash lookups make
+// successor/predecessor O(log log U) expected.
+// Since every 64-bit value is a valid key, emptiness is a flag and queries report
+// "no answer" through their return value.
+
+struct V64 {
+    int bits, B; // universe bits, block bits
+    bool empty;
+    uint64_t min, max;
+    uint64_t small; // if U is small ( <= 64) use a bitmask
+
+    V64* summary; // nullptr while there are no clusters
+    std::unordered_map<uint64_t, V64*> block; // non-empty clusters only
+
+    explicit V64(int bits = 64);
+    ~V64();
+
+    // helper functions
+    uint64_t index(uint64_t i, uint64_t j) const;
+    uint64_t high(uint64_t x) const;
+    uint64_t low(uint64_t x) const;
+
+    void insert(uint64_t x); // assumes x not in VEB
+    void erase(uint64_t x);
+    bool successor(uint64_t x, uint64_t& y) const; // sets y and returns true if x has a successor
+    bool predecessor(uint64_t x, uint64_t& y) const; // sets y and returns true if x has a predecessor
+    bool floor(uint64_t x, uint64_t& y) const; // sets y to the largest key <= x and returns true if there is one
+    bool contains(uint64_t x) const;
+};
+
+V64::V64(int bits) : bits(bits), B(bits >> 1), empty(true), min(0), max(0), small(0), summary(nullptr) {}
+
+V64::~V64() {
+    delete summary;
+    for (auto& c : block) delete c.second;
+}
+
+uint64_t V64::index(uint64_t i, uint64_t j) const { return i << B | j; }
+uint64_t V64::high(uint64_t x) const { return x >> B; }
+uint64_t V64::low(uint64_t x) const { return x & ((1ULL << B) - 1); }
+
+void V64::insert(uint64_t x) {
+    if (empty) {
+        min = max = x;
+        empty = false;
+        return;
+    }
+
+    if (x < min) std::swap(x, min);
+    if (x > max) max = x;
+
+    if (bits <= 6) {
+        small |= 1ULL << x;
+        return;
+    }
+
+    uint64_t i = high(x);
+    V64*& c = block[i];
+    if (c == nullptr) {
+        c = new V64(B);
+        if (summary == nullptr) summary = new V64(bits - B);
+        summary->insert(i);
+    }
+
+    c->insert(low(x));
+}
+
+void V64::erase(uint64_t x) {
+    if (empty) return;
+
+    if (bits <= 6) {
+        if (x == min) {
+            if (small == 0) { // deleting last element
+                empty = true;
+                return;
+            }
+            min = __builtin_ctzll(small); // min is not kept in the bitmask
+            small &= small - 1;
+        } else {
+            small &= ~(1ULL << x);
+        }
+        max = small ? 63 - __builtin_clzll(small) : min;
+        return;
+    }
+
+    if (x == min) {
+        if (summary == nullptr) { // deleting last element
+            empty = true;
+            return;
+        }
+        uint64_t i = summary->min;
+        x = min = index(i, block[i]->min); // next smallest element
+    }
+
+    auto it = block.find(high(x));
+    if (it == block.end()) return; // x not in VEB
+
+    V64* c = it->second;
+    c->erase(low(x));
+    if (c->empty) {
+        delete c;
+        block.erase(it);
+        summary->erase(high(x));
+        if (summary->empty) {
+            delete summary;
+            summary = nullptr;
+        }
+    }
+
+    if (x == max) {
+        if (summary == nullptr)
+            max = min;
+        else
+            max = index(summary->max, block[summary->max]->max);
+    }
+}
+
+bool V64::successor(uint64_t x, uint64_t& y) const {
+    if (empty) return false;
+    if (x < min) {
+        y = min;
+        return true;
+    }
+
+    if (bits <= 6) {
+        uint64_t above = x >= 63 ? 0 : small & (~0ULL << (x + 1));
+        if (above) y = __builtin_ctzll(above);
+        return above != 0;
+    }
+
+    uint64_t i = high(x), j = low(x);
+    auto it = block.find(i);
+
+    if (it != block.end() && j < it->second->max) {
+        it->second->successor(j, j);
+    } else {
+        if (summary == nullptr || !summary->successor(i, i)) return false;
+        j = block.find(i)->second->min;
+    }
+
+    y = index(i, j);
+    return true;
+}
+
+bool V64::predecessor(uint64_t x, uint64_t& y) const {
+    return x != 0 && floor(x - 1, y);
+}
+
+bool V64::floor(uint64_t x, uint64_t& y) const {
+    if (empty || x < min) return false;
+    if (x >= max || x == min) {
+        y = x >= max ? max : min;
+        return true;
+    }
+
+    if (bits <= 6) {
+        uint64_t below = small & ((2ULL << x) - 1); // x < max <= 63
+        y = below ? 63 - __builtin_clzll(below) : min;
+        return true;
+    }
+
+    uint64_t i = high(x), j = low(x);
+    auto it = block.find(i);
+
+    if (it != block.end() && j >= it->second->min) {
+        it->second->floor(j, j);
+    } else if (summary != nullptr && summary->predecessor(i, i)) {
+        j = block.find(i)->second->max;
+    } else {
+        y = min;
+        return true;
+    }
+
+    y = index(i, j);
+    return true;
+}
+
+bool V64::contains(uint64_t x) const {
+    if (empty) return false;
+    if (x == min) return true;
+    if (bits <= 6) return small >> x & 1;
+
+    auto it = block.find(high(x));
+    return it != block.end() && it->second->contains(low(x));
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Van Emde Boas map: every key carries a Value, stored in the tree itself next to the key,
+// so successor / predecessor / find return the key and its payload in one descent.
+// The min of a node is not stored in its clusters, so its payload is kept in the node
+// (value); leaves keep the payloads of the other keys in values[], indexed like small.
+// The summary needs no payloads and is a plain LAZY V. Clusters are always allocated
+// on first insert and freed when empty, as in V::LAZY.
+// Value must be default constructible and movable.
+
+template<class Value>
+struct VEBMap {
+    int U, B; // universe size, block size
+    int min, max;
+    Value value; // payload of min
+    uint64_t small; // leaf keys (except min) as a bitmask
+    std::vector<Value> values; // leaf only: values[x] is the payload of x in small
+
+    V* summary; // nullptr while no cluster is allocated
+    std::vector<VEBMap*> block; // block[i] == nullptr means cluster i is empty
+
+    explicit VEBMap(int bits);
+    ~VEBMap();
+
+    // helper functions
+    int index(int i, int j) const { return i << B | j; }
+    int high(int x) const { return x >> B; }
+    int low(int x) const { return x & ((1 << B) - 1); }
+    VEBMap* at(int i) const { return block.empty() ? nullptr : block[i]; }
+    int last(Value*& v); // returns max, with its payload
+
+    void insert(int x, Value v); // assumes x not in map
+    void erase(int x);
+    Value* find(int x); // returns nullptr if x is not in map
+    int successor(int x, Value*& v); // returns -1 if x has no successor, else sets v to its payload
+    int predecessor(int x, Value*& v); // returns -1 if x has no predecessor, else sets v to its payload
+    int floor(int x, Value*& v); // largest key <= x (-1 if there is none) and its payload
+    bool contains(int x) const;
+};
+
+template<class Value>
+VEBMap<Value>::VEBMap(int bits) : U(1 << bits), B(bits >> 1), min(-1), max(-1), value(), small(0), summary(nullptr) {
+    if (U <= SMALL) values.resize(U);
+}
+
+template<class Value>
+VEBMap<Value>::~VEBMap() {
+    delete summary;
+    for (VEBMap* v : block) delete v;
+}
+
+template<class Value>
+int VEBMap<Value>::last(Value*& v) {
+    if (max == min) v = &value;
+    else if (U <= SMALL) v = &values[max];
+    else block[summary->max]->last(v);
+    return max;
+}
+
+template<class Value>
+void VEBMap<Value>::insert(int x, Value v) {
+    assert(0 <= x && x < U);
+
+    if (min == -1) {
+        min = max = x;
+        value = std::move(v);
+        return;
+    }
+
+    if (x < min) { // x becomes the new min, the old one goes down with its payload
+        std::swap(x, min);
+        std::swap(v, value);
+    }
+    if (x > max) max = x;
+
+    if (U <= SMALL) {
+        small |= 1ULL << x;
+        values[x] = std::move(v);
+        return;
+    }
+
+    int i = high(x), j = low(x);
+    if (block.empty()) block.resize(U >> B, nullptr);
+    if (summary == nullptr) summary = new V(__builtin_ctz(U) - B, V::LAZY);
+    if (block[i] == nullptr) {
+        block[i] = new VEBMap(B);
+        summary->insert(i);
+    }
+
+    block[i]->insert(j, std::move(v));
+}
+
+template<class Value>
+void VEBMap<Value>::erase(int x) {
+    assert(0 <= x && x < U);
+
+    if (U <= SMALL) {
+        if (x == min) {
+            if (small == 0) { // deleting last element
+                min = max = -1;
+                value = Value();
+                return;
+            }
+            min = __builtin_ctzll(small); // min is not kept in the bitmask
+            value = std::move(values[min]);
+            small &= small - 1;
+        } else {
+            small &= ~(1ULL << x);
+            values[x] = Value();
+        }
+        max = small ? 63 - __builtin_clzll(small) : min;
+        return;
+    }
+
+    if (x == min) {
+        int i = summary == nullptr ? -1 : summary->min;
+        if (i == -1) { // deleting last element
+            min = max = -1;
+            value = Value();
+            return;
+        }
+        x = min = index(i, block[i]->min); // next smallest element
+        value = std::move(block[i]->value);
+    }
+
+    int i = high(x);
+    VEBMap* c = at(i);
+    if (c == nullptr) return; // x not in map
+
+    c->erase(low(x));
+    if (c->min == -1) {
+        summary->erase(i);
+        delete c;
+        block[i] = nullptr;
+        if (summary->min == -1) {
+            delete summary;
+            summary = nullptr;
+            std::vector<VEBMap*>().swap(block);
+        }
+    }
+
+    if (x == max) {
+        i = summary == nullptr ? -1 : summary->max;
+        if (i == -1)
+            max = min;
+        else
+            max = index(i, block[i]->max);
+    }
+}
+
+template<class Value>
+Value* VEBMap<Value>::find(int x) {
+    assert(0 <= x && x < U);
+
+    if (x == min) return &value;
+    if (U <= SMALL) return small >> x & 1 ? &values[x] : nullptr;
+
+    VEBMap* c = at(high(x));
+    return c == nullptr ? nullptr : c->find(low(x));
+}
+
+template<class Value>
+int VEBMap<Value>::successor(int x, Value*& v) {
+    assert(0 <= x && x < U);
+
+    if (x < min) {
+        v = &value;
+        return min;
+    }
+
+    if (U <= SMALL) {
+        uint64_t above = x == 63 ? 0 : small & (~0ULL << (x + 1));
+        if (!above) return -1;
+        int y = __builtin_ctzll(above);
+        v = &values[y];
+        return y;
+    }
+
+    int i = high(x), j = low(x);
+    VEBMap* c = at(i);
+
+    if (c != nullptr && j < c->max) {
+        j = c->successor(j, v);
+    } else {
+        i = summary == nullptr ? -1 : summary->successor(i);
+        if (i == -1) return -1;
+        j = block[i]->min;
+        v = &block[i]->value;
+    }
+
+    return index(i, j);
+}
+
+template<class Value>
+int VEBMap<Value>::predecessor(int x, Value*& v) {
+    assert(0 <= x && x < U);
+    return x == 0 ? -1 : floor(x - 1, v);
+}
+
+template<class Value>
+int VEBMap<Value>::floor(int x, Value*& v) {
+    assert(0 <= x && x < U);
+
+    if (x >= max) return last(v); // also covers the empty map
+    if (x < min) return -1;
+    if (x == min) {
+        v = &value;
+        return min;
+    }
+
+    if (U <= SMALL) {
+        uint64_t below = small & ((2ULL << x) - 1); // x < max <= 63
+        if (!below) {
+            v = &value;
+            return min;
+        }
+        int y = 63 - __builtin_clzll(below);
+        v = &values[y];
+        return y;
+    }
+
+    int i = high(x), j = low(x);
+    VEBMap* c = at(i);
+
+    if (c != nullptr && j >= c->min) {
+        j = c->floor(j, v);
+    } else {
+        i = summary == nullptr ? -1 : summary->predecessor(i);
+        if (i == -1) {
+            v = &value;
+            return min;
+        }
+        j = block[i]->last(v);
+    }
+
+    return index(i, j);
+}
+
+template<class Value>
+bool VEBMap<Value>::contains(int x) const {
+    if (x == min) return true;
+    if (U <= SMALL) return small >> x & 1;
+
+    const VEBMap* c = at(high(x));
+    return c != nullptr && c->contains(low(x));
+}
+
+// Van Emde Boas multiset: a VEBMap from each distinct key to its multiplicity.
+// Inserting a key that is already present or erasing one of several copies only changes
+// its count in place; the tree itself is only touched when a count goes 0 -> 1 or 1 -> 0.
+// Erasing a key that is not present is a no-op.
+
+struct VEBMultiset {
+    mutable VEBMap<int> counts; // queries hand out payload pointers, hence mutable
+    long long total; // number of keys, copies included
+
+    explicit VEBMultiset(int bits);
+
+    void insert(int x); // adds one copy of x
+    bool erase(int x); // removes one copy of x, returns false if there was none
+    int count(int x) const;
+    int successor(int x) const; // returns -1 if x has no successor
+    int predecessor(int x) const; // returns -1 if x has no predecessor
+    bool contains(int x) const;
+    long long size() const;
+};
+
+VEBMultiset::VEBMultiset(int bits) : counts(bits), total(0) {}
+
+void VEBMultiset::insert(int x) {
+    int* c = counts.find(x);
+    if (c != nullptr) ++*c;
+    else counts.insert(x, 1);
+    total++;
+}
+
+bool VEBMultiset::erase(int x) {
+    int* c = counts.find(x);
+    if (c == nullptr) return false;
+    if (--*c == 0) counts.erase(x);
+    total--;
+    return true;
+}
+
+int VEBMultiset::count(int x) const {
+    int* c = counts.find(x);
+    return c == nullptr ? 0 : *c;
+}
+
+int VEBMultiset::successor(int x) const {
+    int* c;
+    return counts.successor(x, c);
+}
+
+int VEBMultiset::predecessor(int x) const {
+    int* c;
+    return counts.predecessor(x, c);
+}
+
+bool VEBMultiset::contains(int x) const { return counts.contains(x); }
+long long VEBMultiset::size() const { return total; }
+
+// Indexed priority queue over items 0..items-1 with integer priorities in [0, 2^bits).
+// head is a VEBMap from each used priority to the first item of its bucket, and the items
+// sharing a priority form a doubly linked list through next/prev, so duplicate priorities
+// cost nothing in the tree. The smallest priority is head.min and its bucket head.value,
+// which makes top() O(1); push, pop_min and decrease_key touch the tree only when a
+// bucket is created or emptied, O(log log U), and are O(1) otherwise.
+
+struct VEBPriorityQueue {
+    VEBMap<int> head; // priority -> first item of its bucket
+    std::vector<int> prio, next, prev; // per item; prio[item] == -1 when item is not queued
+    int count;
+
+    VEBPriorityQueue(int bits, int items);
+
+    // helper functions
+    void unlink(int item);
+
+    bool empty() const;
+    int size() const;
+    bool contains(int item) const;
+    int priority(int item) const;
+    int top() const; // item with the smallest priority, queue must not be empty
+    int top_priority() const;
+
+    void push(int item, int p); // assumes item not queued
+    int pop_min(); // removes and returns top()
+    void decrease_key(int item, int p); // assumes item queued with priority >= p
+    void erase(int item); // assumes item queued
+};
+
+VEBPriorityQueue::VEBPriorityQueue(int bits, int items) : head(bits), prio(items, -1), next(items), prev(items),
+                                                          count(0) {}
+
+void VEBPriorityQueue::unlink(int item) {
+    int p = prio[item];
+    if (prev[item] != -1) {
+        next[prev[item]] = next[item];
+    } else if (next[item] == -1) { // last item of its bucket
+        head.erase(p);
+    } else {
+        *head.find(p) = next[item]; // O(1) for the min bucket
+    }
+    if (next[item] != -1) prev[next[item]] = prev[item];
+
+    prio[item] = -1;
+    count--;
+}
+
+bool VEBPriorityQueue::empty() const { return count == 0; }
+int VEBPriorityQueue::size() const { return count; }
+bool VEBPriorityQueue::contains(int item) const { return prio[item] != -1; }
+int VEBPriorityQueue::priority(int item) const { return prio[item]; }
+int VEBPriorityQueue::top() const { return head.value; }
+int VEBPriorityQueue::top_priority() const { return head.min; }
+
+void VEBPriorityQueue::push(int item, int p) {
+    assert(prio[item] == -1 && 0 <= p && p < head.U);
+
+    int* first = head.find(p);
+    prev[item] = -1;
+    if (first == nullptr) {
+        next[item] = -1;
+        head.insert(p, item);
+    } else {
+        next[item] = *first;
+        prev[*first] = item;
+        *first = item;
+    }
+
+    prio[item] = p;
+    count++;
+}
+
+int VEBPriorityQueue::pop_min() {
+    int item = head.value;
+    unlink(item);
+    return item;
+}
+
+void VEBPriorityQueue::decrease_key(int item, int p) {
+    assert(prio[item] != -1 && p <= prio[item]);
+    if (p == prio[item]) return;
+
+    unlink(item);
+    push(item, p);
+}
+
+void VEBPriorityQueue::erase(int item) {
+    assert(prio[item] != -1);
+    unlink(item);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Concurrent Van Emde Boas tree with per-cluster reader-writer locks.
+// The top level is split into clusters block[i], each a V guarded by its own lock[i], plus
+// a summary V of the non-empty clusters guarded by summary_lock. There is no global lock:
+// readers take shared locks on the one cluster they look at (and briefly on the summary
+// when they have to move to a later cluster), writers lock only the cluster they modify
+// and the summary when that cluster becomes empty or non-empty. Locks are always taken
+// cluster first, then summary, and readers never hold two at once.
+
+struct LockedV {
+    int bits, B; // universe bits, block bits
+
+    std::vector<V*> block;
+    mutable std::vector<std::shared_mutex> lock; // lock[i] guards block[i]
+    V* summary;
+    mutable std::shared_mutex summary_lock;
+
+    explicit LockedV(int bits, int flags = 0);
+    ~LockedV();
+
+    // helper functions
+    int index(int i, int j) const;
+    int high(int x) const;
+    int low(int x) const;
+
+    void insert(int x); // no-op if x is already in VEB
+    void erase(int x); // no-op if x is not in VEB
+    int successor(int x) const; // returns -1 if x has no successor
+    int predecessor(int x) const; // returns -1 if x has no predecessor
+    bool contains(int x) const;
+};
+
+LockedV::LockedV(int bits, int flags) : bits(bits), B(bits >> 1), block(1 << (bits - (bits >> 1))),
+                                        lock(1 << (bits - (bits >> 1))) {
+    for (V*& c : block) c = new V(B, flags);
+    summary = new V(bits - B, flags);
+}
+
+LockedV::~LockedV() {
+    delete summary;
+    for (V* c : block) delete c;
+}
+
+int LockedV::index(int i, int j) const { return i << B | j; }
+int LockedV::high(int x) const { return x >> B; }
+int LockedV::low(int x) const { return x & ((1 << B) - 1); }
+
+void LockedV::insert(int x) {
+    int i = high(x), j = low(x);
+    std::unique_lock<std::shared_mutex> guard(lock[i]);
+    bool wasEmpty = block[i]->min == -1;
+    if (!block[i]->insert(j)) return;
+    if (wasEmpty) {
+        std::unique_lock<std::shared_mutex> s(summary_lock);
+        summary->insert(i);
+    }
+}
+
+void LockedV::erase(int x) {
+    int i = high(x), j = low(x);
+    std::unique_lock<std::shared_mutex> guard(lock[i]);
+    if (!block[i]->erase(j)) return;
+    if (block[i]->min == -1) {
+        std::unique_lock<std::shared_mutex> s(summary_lock);
+        summary->erase(i);
+    }
+}
+
+int LockedV::successor(int x) const {
+    int i = high(x), j = low(x);
+    {
+        std::shared_lock<std::shared_mutex> guard(lock[i]);
+        if (j < block[i]->max) return index(i, block[i]->successor(j));
+    }
+
+    // the summary may be a step behind a concurrent writer, so recheck each candidate
+    for (;;) {
+        {
+            std::shared_lock<std::shared_mutex> s(summary_lock);
+            i = summary->successor(i);
+        }
+        if (i == -1) return -1;
+
+        std::shared_lock<std::shared_mutex> guard(lock[i]);
+        if (block[i]->min != -1) return index(i, block[i]->min);
+    }
+}
+
+int LockedV::predecessor(int x) const {
+    int i = high(x), j = low(x);
+    {
+        std::shared_lock<std::shared_mutex> guard(lock[i]);
+        if (block[i]->min != -1 && j > block[i]->min) return index(i, block[i]->predecessor(j));
+    }
+
+    for (;;) {
+        {
+            std::shared_lock<std::shared_mutex> s(summary_lock);
+            i = i == 0 ? -1 : summary->predecessor(i);
+        }
+        if (i == -1) return -1;
+
+        std::shared_lock<std::shared_mutex> guard(lock[i]);
+        if (block[i]->max != -1) return index(i, block[i]->max);
+    }
+}
+
+bool LockedV::contains(int x) const {
+    std::shared_lock<std::shared_mutex> guard(lock[high(x)]);
+    return block[high(x)]->contains(low(x));
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Van Emde Boas tree with snapshot reads.
+// Nodes are immutable once published: a write copies the nodes on its path (copy-on-write),
+// links the copies to the untouched subtrees and publishes the new root atomically. A reader
+// pins the current epoch and takes the root it finds, and from then on owns a consistent
+// view it can iterate at full speed while writers carry on; it never blocks them and is
+// never blocked. Replaced nodes are retired with the epoch they were replaced in and freed
+// once every pinned reader has moved past that epoch (epoch-based reclamation).
+// Writers are serialised among themselves. Empty subtrees are nullptr.
+// A node's cluster table is a tree of pages of at most 256 slots rather than one array: up to
+// 256 clusters it is a single page (as cheap to read as an array), 2^13 clusters take a page
+// of 32 over pages of 256. A write copies one page per page level, O(256) pointers per vEB
+// level however large the universe, instead of the whole table.
+
+#define SNAPSHOT_READERS 64
+#define SNAPSHOT_PAGE_BITS 8 // a page of a cluster table has at most 2^8 slots
+
+struct SnapshotV {
+    // a page is an array of slots: clusters (const Node*) on the lowest level, pages above
+    typedef const void* Slot;
+
+    struct Node {
+        int min, max;
+        uint64_t small; // bitmask of a leaf ( U <= 64 )
+        const Node* summary;
+        const Slot* block; // cluster table, nullptr while every cluster is empty
+    };
+
+    // nodes and pages replaced by one write
+    struct Retired {
+        std::vector<const Node*> nodes;
+        std::vector<const Slot*> pages;
+    };
+
+    // a pinned, consistent view of the tree
+    struct Snapshot {
+        const SnapshotV* tree;
+        int slot;
+        const Node* root;
+
+        Snapshot(const SnapshotV* tree, int slot, const Node* root);
+        Snapshot(Snapshot&& o);
+        ~Snapshot();
+
+        int successor(int x) const; // returns -1 if x has no successor
+        int predecessor(int x) const; // returns -1 if x has no predecessor
+        int floor(int x) const; // largest key <= x, -1 if there is none
+        bool contains(int x) const;
+    };
+
+    int bits;
+    std::atomic<const Node*> root;
+    std::mutex writer;
+
+    std::atomic<uint64_t> epoch;
+    mutable std::atomic<uint64_t> pinned[SNAPSHOT_READERS]; // epoch pinned by each reader slot, 0 = free
+    std::vector<std::pair<uint64_t, Retired>> limbo; // retired nodes and pages by epoch
+
+    explicit SnapshotV(int bits);
+    ~SnapshotV();
+
+    Snapshot snapshot() const;
+
+    bool insert(int x); // returns false if x was already in VEB
+    bool erase(int x); // returns false if x was not in VEB
+    int successor(int x) const; // one-off queries, each on a fresh snapshot
+    int predecessor(int x) const;
+    int floor(int x) const;
+    bool contains(int x) const;
+
+    // path-copying updates and queries on one version, b = universe bits of t
+    static const Node* insert(const Node* t, int b, int x, Retired& retired);
+    static const Node* erase(const Node* t, int b, int x, Retired& retired);
+    static int successor(const Node* t, int b, int x);
+    static int floor(const Node* t, int b, int x);
+    static bool contains(const Node* t, int b, int x);
+    static void destroy(const Node* t, int b);
+
+    // cluster tables over 2^cb clusters, h = page levels from p down
+    static int height(int cb);
+    static int slots(int cb, int h);
+    static const Node* cluster(const Node* t, int b, int i);
+    static const Slot* set_cluster(const Slot* p, int cb, int h, int i, const Node* c, Retired& retired);
+    static void destroy(const Slot* p, int cb, int h, int b);
+    static void reclaim(Retired& retired);
+
+    void publish(const Node* next, Retired& retired);
+};
+
+SnapshotV::SnapshotV(int bits) : bits(bits), root(nullptr), epoch(1) {
+    for (std::atomic<uint64_t>& p : pinned) p.store(0);
+}
+
+SnapshotV::~SnapshotV() {
+    destroy(root.load(), bits);
+    for (auto& retired : limbo) reclaim(retired.second);
+}
+
+void SnapshotV::destroy(const Node* t, int b) {
+    if (t == nullptr) return;
+    if ((1 << b) > SMALL) {
+        destroy(t->summary, b - (b >> 1));
+        int cb = b - (b >> 1);
+        destroy(t->block, cb, height(cb), b >> 1);
+    }
+    delete t;
+}
+
+// frees a cluster table whose clusters have b bits
+void SnapshotV::destroy(const Slot* p, int cb, int h, int b) {
+    if (p == nullptr) return;
+    for (int k = 0; k < slots(cb, h); k++) {
+        if (h == 1) destroy((const Node*) p[k], b);
+        else destroy((const Slot*) p[k], cb, h - 1, b);
+    }
+    delete[] p;
+}
+
+void SnapshotV::reclaim(Retired& retired) {
+    for (const Node* t : retired.nodes) delete t;
+    for (const Slot* p : retired.pages) delete[] p;
+}
+
+int SnapshotV::height(int cb) {
+    return std::max(1, (cb + SNAPSHOT_PAGE_BITS - 1) / SNAPSHOT_PAGE_BITS);
+}
+
+// size of a page h levels above the clusters; only the top page may be smaller than 2^8
+int SnapshotV::slots(int cb, int h) {
+    return 1 << (h == height(cb) ? cb - SNAPSHOT_PAGE_BITS * (h - 1) : SNAPSHOT_PAGE_BITS);
+}
+
+// cluster i of t, nullptr if it is empty
+const SnapshotV::Node* SnapshotV::cluster(const Node* t, int b, int i) {
+    const int mask = (1 << SNAPSHOT_PAGE_BITS) - 1;
+    const Slot* p = t->block;
+    for (int h = height(b - (b >> 1)); p != nullptr && h > 1; h--) p = (const Slot*) p[i >> SNAPSHOT_PAGE_BITS * (h - 1) & mask];
+    return p == nullptr ? nullptr : (const Node*) p[i & mask];
+}
+
+// copy of the table p (h page levels) with cluster i set to c; pages left with no clusters
+// are dropped, so the table of a node without clusters is nullptr
+const SnapshotV::Slot* SnapshotV::set_cluster(const Slot* p, int cb, int h, int i, const Node* c, Retired& retired) {
+    int n = slots(cb, h), k = i >> SNAPSHOT_PAGE_BITS * (h - 1) & ((1 << SNAPSHOT_PAGE_BITS) - 1);
+    Slot* q = new Slot[n];
+    if (p) {
+        std::copy(p, p + n, q);
+        retired.pages.push_back(p);
+    } else {
+        std::fill(q, q + n, nullptr);
+    }
+
+    q[k] = h == 1 ? (Slot) c : set_cluster((const Slot*) q[k], cb, h - 1, i, c, retired);
+
+    if (q[k] == nullptr && std::all_of(q, q + n, [](Slot s) { return s == nullptr; })) {
+        delete[] q;
+        return nullptr;
+    }
+    return q;
+}
+
+SnapshotV::Snapshot::Snapshot(const SnapshotV* tree, int slot, const Node* root) : tree(tree), slot(slot), root(root) {}
+
+SnapshotV::Snapshot::Snapshot(Snapshot&& o) : tree(o.tree), slot(o.slot), root(o.root) { o.slot = -1; }
+
+SnapshotV::Snapshot::~Snapshot() {
+    if (slot != -1) tree->pinned[slot].store(0);
+}
+
+int SnapshotV::Snapshot::successor(int x) const { return SnapshotV::successor(root, tree->bits, x); }
+int SnapshotV::Snapshot::predecessor(int x) const { return x == 0 ? -1 : SnapshotV::floor(root, tree->bits, x - 1); }
+int SnapshotV::Snapshot::floor(int x) const { return SnapshotV::floor(root, tree->bits, x); }
+bool SnapshotV::Snapshot::contains(int x) const { return SnapshotV::contains(root, tree->bits, x); }
+
+SnapshotV::Snapshot SnapshotV::snapshot() const {
+    for (int slot = 0;; slot = (slot + 1) % SNAPSHOT_READERS) {
+        uint64_t free = 0;
+        if (pinned[slot].compare_exchange_strong(free, epoch.load())) {
+            return Snapshot(this, slot, root.load());
+        }
+        if (slot == SNAPSHOT_READERS - 1) std::this_thread::yield();
+    }
+}
+
+int SnapshotV::successor(int x) const { return snapshot().successor(x); }
+int SnapshotV::predecessor(int x) const { return snapshot().predecessor(x); }
+int SnapshotV::floor(int x) const { return snapshot().floor(x); }
+bool SnapshotV::contains(int x) const { return snapshot().contains(x); }
+
+bool SnapshotV::insert(int x) {
+    std::lock_guard<std::mutex> guard(writer);
+    const Node* t = root.load();
+    if (contains(t, bits, x)) return false;
+
+    Retired retired;
+    publish(insert(t, bits, x, retired), retired);
+    return true;
+}
+
+bool SnapshotV::erase(int x) {
+    std::lock_guard<std::mutex> guard(writer);
+    const Node* t = root.load();
+    if (!contains(t, bits, x)) return false;
+
+    Retired retired;
+    publish(erase(t, bits, x, retired), retired);
+    return true;
+}
+
+// swaps in the new root, then frees whatever no pinned reader can still see
+void SnapshotV::publish(const Node* next, Retired& retired) {
+    root.store(next);
+    limbo.emplace_back(epoch.fetch_add(1), std::move(retired));
+
+    uint64_t oldest = epoch.load();
+    for (const std::atomic<uint64_t>& p : pinned) {
+        uint64_t e = p.load();
+        if (e != 0) oldest = std::min(oldest, e);
+    }
+
+    size_t k = 0;
+    for (; k < limbo.size() && limbo[k].first < oldest; k++) reclaim(limbo[k].second);
+    limbo.erase(limbo.begin(), limbo.begin() + k);
+}
+
+const SnapshotV::Node* SnapshotV::insert(const Node* t, int b, int x, Retired& retired) {
+    Node* n = t ? new Node(*t) : new Node{-1, -1, 0, nullptr, nullptr};
+    if (t) retired.nodes.push_back(t);
+
+    if (n->min == -1) {
+        n->min = n->max = x;
+        return n;
+    }
+
+    if (x < n->min) std::swap(x, n->min);
+    if (x > n->max) n->max = x;
+
+    if ((1 << b) <= SMALL) {
+        n->small |= 1ULL << x;
+        return n;
+    }
+
+    int B = b >> 1, i = x >> B, j = x & ((1 << B) - 1);
+    const Node* c = cluster(n, b, i);
+    if (c == nullptr)
+        n->summary = insert(n->summary, b - B, i, retired);
+
+    n->block = set_cluster(n->block, b - B, height(b - B), i, insert(c, B, j, retired), retired);
+    return n;
+}
+
+// assumes x is in t, returns nullptr once the subtree is empty
+const SnapshotV::Node* SnapshotV::erase(const Node* t, int b, int x, Retired& retired) {
+    retired.nodes.push_back(t);
+
+    if ((1 << b) <= SMALL) {
+        if (x == t->min && t->small == 0) return nullptr; // deleting last element
+
+        Node* n = new Node(*t);
+        if (x == n->min) {
+            n->min = __builtin_ctzll(n->small); // min is not kept in the bitmask
+            n->small &= n->small - 1;
+        } else {
+            n->small &= ~(1ULL << x);
+        }
+        n->max = n->small ? 63 - __builtin_clzll(n->small) : n->min;
+        return n;
+    }
+
+    if (x == t->min && t->summary == nullptr) return nullptr; // deleting last element
+
+    Node* n = new Node(*t);
+    int B = b >> 1;
+
+    if (x == n->min) {
+        int i = n->summary->min;
+        x = n->min = i << B | cluster(n, b, i)->min; // next smallest element
+    }
+
+    int i = x >> B;
+    const Node* c = erase(cluster(n, b, i), B, x & ((1 << B) - 1), retired);
+    n->block = set_cluster(n->block, b - B, height(b - B), i, c, retired);
+    if (c == nullptr) n->summary = erase(n->summary, b - B, i, retired);
+
+    if (x == n->max) {
+        if (n->summary == nullptr)
+            n->max = n->min;
+        else
+            n->max = n->summary->max << B | cluster(n, b, n->summary->max)->max;
+    }
+    return n;
+}
+
+int SnapshotV::successor(const Node* t, int b, int x) {
+    if (t == nullptr) return -1;
+    if (x < t->min) return t->min;
+
+    if ((1 << b) <= SMALL) {
+        uint64_t above = x == 63 ? 0 : t->small & (~0ULL << (x + 1));
+        return above ? __builtin_ctzll(above) : -1;
+    }
+
+    int B = b >> 1, i = x >> B, j = x & ((1 << B) - 1);
+    const Node* c = cluster(t, b, i);
+
+    if (c != nullptr && j < c->max) {
+        j = successor(c, B, j);
+    } else {
+        i = successor(t->summary, b - B, i);
+        if (i == -1) return -1;
+        j = cluster(t, b, i)->min;
+    }
+
+    return i << B | j;
+}
+
+int SnapshotV::floor(const Node* t, int b, int x) {
+    if (t == nullptr) return -1;
+    if (x >= t->max) return t->max;
+    if (x <= t->min) return x == t->min ? t->min : -1;
+
+    if ((1 << b) <= SMALL) {
+        uint64_t below = t->small & ((2ULL << x) - 1); // x < max <= 63
+        return below ? 63 - __builtin_clzll(below) : t->min;
+    }
+
+    int B = b >> 1, i = x >> B, j = x & ((1 << B) - 1);
+    const Node* c = cluster(t, b, i);
+
+    if (c != nullptr && j >= c->min) {
+        j = floor(c, B, j);
+    } else {
+        i = i == 0 ? -1 : floor(t->summary, b - B, i - 1);
+        if (i == -1) return t->min;
+        j = cluster(t, b, i)->max;
+    }
+
+    return i << B | j;
+}
+
+bool SnapshotV::contains(const Node* t, int b, int x) {
+    if (t == nullptr) return false;
+    if (x == t->min) return true;
+    if ((1 << b) <= SMALL) return t->small >> x & 1;
+
+    int B = b >> 1;
+    return contains(cluster(t, b, x >> B), B, x & ((1 << B) - 1));
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Concurrent Van Emde Boas tree with lock-free leaves. Keys are split into leaves of 32:
+// leaf i is one atomic 64-bit word holding keys 32i..32i+31 as bits in its low half and a
+// version in its high half, and the top of the tree is a SnapshotV over the leaf numbers,
+// whose summary and min / max keep track of the non-empty leaves.
+// Writers update a leaf word with a CAS that also bumps its version, with no lock as long as
+// the leaf stays non-empty. A leaf going empty <-> non-empty also changes top, under the
+// writer mutex: top gains the leaf before its word fills and loses it after its word emptied,
+// so a non-empty leaf is always in top.
+// contains is one atomic load. successor / predecessor answered inside x's own leaf are one
+// load too. Otherwise the query takes a snapshot of top (never blocking, never blocked), finds
+// the next leaf j in it and loads j's word, then loads x's leaf again. If that word, version
+// included, is unchanged and top still has the same root, no leaf between x's and j can have
+// filled, and the query is linearizable at the load of j; if not, it is retried. Versions are
+// 32 bits, so a query is only fooled if one leaf changes exactly a multiple of 2^32 times
+// while it runs.
+
+#define ATOMIC_LEAF_BITS 5 // 32 keys per leaf word, its low half
+#define ATOMIC_VERSION (1ULL << 32) // one step of a leaf word's version
+
+struct AtomicV {
+    int bits;
+    std::vector<std::atomic<uint64_t>> leaf; // key bits in the low 32 bits, version in the high 32
+    SnapshotV top; // the non-empty leaves
+    std::mutex writer; // held while a leaf goes empty <-> non-empty and top follows
+
+    explicit AtomicV(int bits);
+
+    bool insert(int x); // returns false if x was already in VEB
+    bool erase(int x); // returns false if x was not in VEB
+    int successor(int x) const; // returns -1 if x has no successor
+    int predecessor(int x) const; // returns -1 if x has no predecessor
+    bool contains(int x) const;
+};
+
+AtomicV::AtomicV(int bits) : bits(bits), leaf(std::max(1, (1 << bits) >> ATOMIC_LEAF_BITS)),
+                             top(std::max(0, bits - ATOMIC_LEAF_BITS)) {
+    for (std::atomic<uint64_t>& w : leaf) w.store(0, std::memory_order_relaxed);
+}
+
+bool AtomicV::insert(int x) {
+    assert(0 <= x && x < (1 << bits));
+    int i = x >> ATOMIC_LEAF_BITS;
+    uint64_t b = 1ULL << (x & 31), w = leaf[i].load();
+
+    while ((uint32_t) w != 0) { // lock-free: non-empty -> non-empty
+        if (w & b) return false;
+        if (leaf[i].compare_exchange_weak(w, (w | b) + ATOMIC_VERSION)) return true;
+    }
+
+    std::lock_guard<std::mutex> guard(writer);
+    w = leaf[i].load();
+    if ((uint32_t) w == 0) top.insert(i); // before the word fills
+    do {
+        if (w & b) return false;
+    } while (!leaf[i].compare_exchange_weak(w, (w | b) + ATOMIC_VERSION));
+    return true;
+}
+
+bool AtomicV::erase(int x) {
+    assert(0 <= x && x < (1 << bits));
+    int i = x >> ATOMIC_LEAF_BITS;
+    uint64_t b = 1ULL << (x & 31), w = leaf[i].load();
+
+    while ((uint32_t) w != b) { // lock-free: non-empty -> non-empty
+        if (!(w & b)) return false;
+        if (leaf[i].compare_exchange_weak(w, (w & ~b) + ATOMIC_VERSION)) return true;
+    }
+
+    // the leaf may go empty, and cannot be refilled while we hold the lock
+    std::lock_guard<std::mutex> guard(writer);
+    w = leaf[i].load();
+    do {
+        if (!(w & b)) return false;
+    } while (!leaf[i].compare_exchange_weak(w, (w & ~b) + ATOMIC_VERSION));
+    if ((uint32_t) w == b) top.erase(i); // after the word emptied
+    return true;
+}
+
+int AtomicV::successor(int x) const {
+    assert(0 <= x && x < (1 << bits));
+    int i = x >> ATOMIC_LEAF_BITS;
+    uint32_t above = (x & 31) == 31 ? 0 : ~0U << ((x & 31) + 1);
+
+    for (;;) {
+        uint64_t w = leaf[i].load();
+        if ((uint32_t) w & above) return i << ATOMIC_LEAF_BITS | __builtin_ctz((uint32_t) w & above);
+
+        // with no later leaf in top, the query holds when the snapshot was taken
+        SnapshotV::Snapshot snap = top.snapshot();
+        int j = snap.successor(i);
+        uint64_t v = j == -1 ? 0 : leaf[j].load();
+        if (leaf[i].load() != w) continue;
+        if (j == -1) return -1;
+        if ((uint32_t) v != 0 && top.root.load() == snap.root) return j << ATOMIC_LEAF_BITS | __builtin_ctz((uint32_t) v);
+    }
+}
+
+int AtomicV::predecessor(int x) const {
+    assert(0 <= x && x < (1 << bits));
+    int i = x >> ATOMIC_LEAF_BITS;
+    uint32_t below = (1U << (x & 31)) - 1;
+
+    for (;;) {
+        uint64_t w = leaf[i].load();
+        if ((uint32_t) w & below) return i << ATOMIC_LEAF_BITS | (31 - __builtin_clz((uint32_t) w & below));
+
+        SnapshotV::Snapshot snap = top.snapshot();
+        int j = snap.predecessor(i);
+        uint64_t v = j == -1 ? 0 : leaf[j].load();
+        if (leaf[i].load() != w) continue;
+        if (j == -1) return -1;
+        if ((uint32_t) v != 0 && top.root.load() == snap.root) return j << ATOMIC_LEAF_BITS | (31 - __builtin_clz((uint32_t) v));
+    }
+}
+
+bool AtomicV::contains(int x) const {
+    return leaf[x >> ATOMIC_LEAF_BITS].load() >> (x & 31) & 1;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Fixed set of worker threads. run(f) calls f(w) once on every worker w = 0..size()-1
+// and returns when all of them are done, so work handed to worker w always runs on the
+// same thread.
+
+struct WorkerPool {
+    std::vector<std::thread> threads;
+    std::mutex m;
+    std::condition_variable wake, finished;
+    std::function<void(int)> job;
+    uint64_t generation;
+    int pending;
+    bool stop;
+
+    explicit WorkerPool(int n);
+    ~WorkerPool();
+
+    int size() const;
+    void run(const std::function<void(int)>& f);
+};
+
+WorkerPool::WorkerPool(int n) : generation(0), pending(0), stop(false) {
+    for (int w = 0; w < n; w++) {
+        threads.emplace_back([this, w]() {
+            uint64_t seen = 0;
+            for (;;) {
+                std::unique_lock<std::mutex> guard(m);
+                wake.wait(guard, [&]() { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+                guard.unlock();
+
+                job(w);
+
+                guard.lock();
+                if (--pending == 0) finished.notify_one();
+            }
+        });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> guard(m);
+        stop = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : threads) t.join();
+}
+
+int WorkerPool::size() const { return threads.size(); }
+
+void WorkerPool::run(const std::function<void(int)>& f) {
+    std::unique_lock<std::mutex> guard(m);
+    job = f;
+    pending = threads.size();
+    generation++;
+    wake.notify_all();
+    finished.wait(guard, [&]() { return pending == 0; });
+}
+
+// Parallel bulk load: the top level is split like in V::build, but the top-level clusters
+// are independent subtrees, so they are filled concurrently. Worker w takes the runs that
+// start in the w-th equal slice of the keys, which balances work by key count rather than
+// by cluster count. An empty cluster is built from its run, one that already holds keys gets
+// the run inserted key by key; either way only the worker owning the run touches block[i].
+// The root's min and max are settled before, the summary and the counts after, on the
+// calling thread. Falls back to the serial load for LAZY trees in an arena, whose allocator
+// is not shared.
+bool V::build_from_sorted(const int* keys, size_t n, WorkerPool& pool) {
+    if (U <= SMALL || ((flags & LAZY) && arena)) return build_from_sorted(keys, n);
+
+    std::vector<int> a;
+    if (!sorted_distinct(keys, n, a)) return false;
+    if (a.empty()) return true;
+
+    // a[first, n) are the keys that go below the root
+    size_t first = 0;
+    if (min == -1) {
+        min = a[0];
+        max = a.back();
+        size = 1;
+        first = 1;
+    } else {
+        auto it = std::lower_bound(a.begin(), a.end(), min);
+        if (it != a.end() && *it == min) a.erase(it);
+        if (a.empty()) return true;
+        if (a[0] < min) { // the old min moves down in place of the new one, as in insert
+            std::swap(a[0], min);
+            for (size_t k = 1; k < a.size() && a[k] < a[k - 1]; k++) std::swap(a[k], a[k - 1]);
+        }
+        max = std::max(max, a.back());
+    }
+    n = a.size();
+    if (first == n) return true;
+
+    if (flags & LAZY) { // allocated here so workers only ever touch their own block[i]
+        if (block.empty()) {
+            block.resize(U >> B, nullptr);
+            if (flags & RANK) count.assign(U >> B, 0);
+        }
+        if (summary == nullptr) summary = make(__builtin_ctz(U) - B, flags & ~RANK);
+    }
+
+    // worker w fills the runs in a[start[w], start[w+1]): slice w of a[first, n) moved to run boundaries
+    int W = pool.size();
+    std::vector<size_t> start(W + 1, n);
+    for (int w = 0; w < W; w++) {
+        size_t k = first + (n - first) * w / W;
+        while (k > first && k < n && high(a[k]) == high(a[k - 1])) k++;
+        start[w] = k;
+    }
+
+    // (cluster, keys added to it) per run, in increasing cluster order
+    std::vector<std::vector<std::pair<int, int>>> runs(W);
+    pool.run([&](int w) {
+        for (size_t k = start[w], e; k < start[w + 1]; k = e) {
+            int i = high(a[k]);
+            for (e = k; e < start[w + 1] && high(a[e]) == i; e++) a[e] = low(a[e]);
+
+            V* c = flags & LAZY ? cluster(i) : block[i];
+            int before = c->size;
+            if (c->min == -1) {
+                c->build(a.data() + k, e - k);
+            } else {
+                for (size_t m = k; m < e; m++) c->insert(a[m]);
+            }
+            runs[w].emplace_back(i, c->size - before);
+        }
+    });
+
+    std::vector<int> filled; // clusters that were empty before this load
+    for (auto& r : runs) {
+        for (auto [i, d] : r) {
+            size += d;
+            counted(i, d);
+            if (block[i]->size == d) filled.push_back(i);
+        }
+    }
+    return summary->build_from_sorted(filled.data(), filled.size());
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Sharded Van Emde Boas tree.
+// The top-level clusters are split into S contiguous ranges, and shard s is a V of its own
+// over keys [s * 2^shardBits, (s+1) * 2^shardBits) owned by worker thread s. A batch is
+// split by owner once (one counting pass on the calling thread), and every worker then runs
+// the keys of its own shard only, so no locks are needed. The only shared state is the summary, one bit per non-empty shard, which each
+// worker updates for its own shard and which successor queries use to cross shards.
+// Batches must not run concurrently with each other or with the single-key operations.
+
+struct ShardedV {
+    int bits, shardBits;
+    std::vector<V*> shard;
+    std::atomic<uint64_t> nonempty; // bit s set while shard s has keys
+    WorkerPool pool;
+
+    ShardedV(int bits, int shards, int flags = 0); // shards is a power of 2, at most 64
+    ~ShardedV();
+
+    // helper functions
+    int owner(int x) const;
+    int low(int x) const;
+    void update_summary(int s);
+    void route(const int* keys, size_t n, std::vector<size_t>& start, std::vector<size_t>& pos) const;
+
+    void insert_batch(const int* keys, size_t n); // keys already present are skipped
+    void erase_batch(const int* keys, size_t n); // keys not present are skipped
+    void successor_batch(const int* xs, int* out, size_t n); // out[k] = successor(xs[k])
+
+    void insert(int x); // single-key operations, run on the calling thread
+    void erase(int x);
+    int successor(int x) const; // returns -1 if x has no successor
+    int predecessor(int x) const; // returns -1 if x has no predecessor
+    bool contains(int x) const;
+};
+
+ShardedV::ShardedV(int bits, int shards, int flags) : bits(bits), shardBits(bits - __builtin_ctz(shards)),
+                                                      shard(shards), nonempty(0), pool(shards) {
+    assert(shards <= 64 && (shards & (shards - 1)) == 0 && shardBits >= 0);
+    for (V*& v : shard) v = new V(shardBits, flags);
+}
+
+ShardedV::~ShardedV() {
+    for (V* v : shard) delete v;
+}
+
+int ShardedV::owner(int x) const { return x >> shardBits; }
+int ShardedV::low(int x) const { return x & ((1 << shardBits) - 1); }
+
+void ShardedV::update_summary(int s) {
+    if (shard[s]->min == -1) nonempty.fetch_and(~(1ULL << s));
+    else nonempty.fetch_or(1ULL << s);
+}
+
+// groups a batch by owner: shard s gets the positions pos[start[s]] .. pos[start[s+1]-1],
+// in batch order
+void ShardedV::route(const int* keys, size_t n, std::vector<size_t>& start, std::vector<size_t>& pos) const {
+    start.assign(shard.size() + 1, 0);
+    for (size_t k = 0; k < n; k++) start[owner(keys[k]) + 1]++;
+    for (size_t s = 0; s < shard.size(); s++) start[s + 1] += start[s];
+
+    std::vector<size_t> next(start.begin(), start.end() - 1);
+    pos.resize(n);
+    for (size_t k = 0; k < n; k++) pos[next[owner(keys[k])]++] = k;
+}
+
+void ShardedV::insert_batch(const int* keys, size_t n) {
+    std::vector<size_t> start, pos;
+    route(keys, n, start, pos);
+    pool.run([&](int s) {
+        V* v = shard[s];
+        for (size_t k = start[s]; k < start[s + 1]; k++) v->insert(low(keys[pos[k]]));
+        update_summary(s);
+    });
+}
+
+void ShardedV::erase_batch(const int* keys, size_t n) {
+    std::vector<size_t> start, pos;
+    route(keys, n, start, pos);
+    pool.run([&](int s) {
+        V* v = shard[s];
+        for (size_t k = start[s]; k < start[s + 1]; k++) v->erase(low(keys[pos[k]]));
+        update_summary(s);
+    });
+}
+
+void ShardedV::successor_batch(const int* xs, int* out, size_t n) {
+    std::vector<size_t> start, pos;
+    route(xs, n, start, pos);
+    pool.run([&](int s) {
+        for (size_t k = start[s]; k < start[s + 1]; k++) out[pos[k]] = successor(xs[pos[k]]);
+    });
+}
+
+void ShardedV::insert(int x) {
+    shard[owner(x)]->insert(low(x));
+    update_summary(owner(x));
+}
+
+void ShardedV::erase(int x) {
+    shard[owner(x)]->erase(low(x));
+    update_summary(owner(x));
+}
+
+int ShardedV::successor(int x) const {
+    int s = owner(x);
+    int y = shard[s]->successor(low(x));
+    if (y != -1) return s << shardBits | y;
+
+    // first non-empty shard after s
+    uint64_t later = s == 63 ? 0 : nonempty.load() & (~0ULL << (s + 1));
+    if (later == 0) return -1;
+    s = __builtin_ctzll(later);
+    return s << shardBits | shard[s]->min;
+}
+
+int ShardedV::predecessor(int x) const {
+    int s = owner(x);
+    int y = shard[s]->predecessor(low(x));
+    if (y != -1) return s << shardBits | y;
+
+    // last non-empty shard before s
+    uint64_t earlier = nonempty.load() & ((1ULL << s) - 1);
+    if (earlier == 0) return -1;
+    s = 63 - __builtin_clzll(earlier);
+    return s << shardBits | shard[s]->max;
+}
+
+bool ShardedV::contains(int x) const {
+    return shard[owner(x)]->contains(low(x));
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Hardware counters for the benchmark suite and check_performance_pipeline, read through
+// perf_event_open around each phase (Linux only; elsewhere no counter opens).
+// Each counter is opened on its own rather than as a group, so one the CPU (or VM) lacks does
+// not take the others down; a counter that cannot be opened (no PMU, perf_event_paranoid too
+// high) reads as -1. Counting covers user space of the calling thread only, so the worker
+// threads of ShardedV are not included. When the kernel multiplexes more counters than the PMU
+// has, the counts are scaled by time enabled / time running.
+
+struct PerfCounters {
+    enum { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, DTLB_MISSES, BRANCH_MISSES, PAGE_FAULTS, EVENTS };
+    static const char* name[EVENTS];
+
+    int fd[EVENTS];
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    int opened() const; // number of counters that could be opened
+    void start(); // reset and enable every counter
+    void stop(size_t n, double per_op[EVENTS]); // disable, per_op[e] = count / n, or -1 if e is not open
+};
+
+const char* PerfCounters::name[EVENTS] = {"cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses",
+                                          "branch_misses", "page_faults"};
+
+PerfCounters::PerfCounters() {
+#ifndef __linux__
+    std::fill(fd, fd + EVENTS, -1);
+#else
+    auto cache = [](uint64_t cache) {
+        return cache | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    };
+    const uint32_t type[EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE,
+                                   PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+    const uint64_t config[EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, cache(PERF_COUNT_HW_CACHE_L1D),
+                                     cache(PERF_COUNT_HW_CACHE_LL), cache(PERF_COUNT_HW_CACHE_DTLB),
+                                     PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_PAGE_FAULTS};
+    for (int e = 0; e < EVENTS; e++) {
+        perf_event_attr attr = {};
+        attr.size = sizeof attr;
+        attr.type = type[e];
+        attr.config = config[e];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fd[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int e = 0; e < EVENTS; e++)
+        if (fd[e] != -1) close(fd[e]);
+#endif
+}
+
+int PerfCounters::opened() const {
+    return std::count_if(fd, fd + EVENTS, [](int f) { return f != -1; });
+}
+
+void PerfCounters::start() {
+#ifdef __linux__
+    for (int e = 0; e < EVENTS; e++) {
+        if (fd[e] == -1) continue;
+        ioctl(fd[e], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+void PerfCounters::stop(size_t n, double per_op[EVENTS]) {
+    std::fill(per_op, per_op + EVENTS, -1);
+#ifdef __linux__
+    for (int e = 0; e < EVENTS; e++)
+        if (fd[e] != -1) ioctl(fd[e], PERF_EVENT_IOC_DISABLE, 0);
+    for (int e = 0; e < EVENTS; e++) {
+        uint64_t v[3]; // value, time enabled, time running
+        if (fd[e] == -1 || read(fd[e], v, sizeof v) != sizeof v || v[2] == 0) continue;
+        per_op[e] = v[0] * ((double) v[1] / v[2]) / std::max<size_t>(n, 1);
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////
+
+int getSuccessor(const std::vector<int>& a, int x) {
+    for (int i = x+1; i < (int) a.size(); i++) {
+        if (a[i] != 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int getPredecessor(const std::vector<int>& a, int x) {
+    for (int i = x-1; i >= 0; i--) {
+        if (a[i] != 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// uses a direct access table to check the correctness of the VEB
+// direct access table uses a linear scan to find successor/predecessor
+template<class T>
+bool check_correctness(T* VEB, int U, int numInserted) {
+    std::vector<int> table(U);
+
+    std::vector<int> inserted(numInserted);
+    for (int i = 0; i < numInserted; i++) {
+        inserted[i] = rand() % U;
+        if (!VEB->contains(inserted[i]))
+            VEB->insert(inserted[i]);
+        else assert(table[inserted[i]] == 1);
+        table[inserted[i]] = 1;
+    }
+
+    for (int round = 0; round < 10; round++) {
+        for (int x = 0; x < U; x++) {
+            // check successor and predecessor of each element are correct
+            if (VEB->successor(x) != getSuccessor(table, x) || VEB->predecessor(x) != getPredecessor(table, x)) {
+                return false;
+            }
+        }
+
+        // walk all keys in descending order
+        int expected = getPredecessor(table, U);
+        for (int x = VEB->contains(U - 1) ? U - 1 : VEB->predecessor(U - 1); x != -1; x = VEB->predecessor(x)) {
+            if (x != expected) return false;
+            expected = getPredecessor(table, x);
+        }
+        if (expected != -1) return false;
+
+        // remove some random elements
+        for (int i = 0; i < 20 && !inserted.empty(); i++) {
+            int n = inserted.size();
+
+            std::swap(inserted[rand() % n], inserted.back());
+            int x = inserted.back();
+            inserted.pop_back();
+
+            table[x] = 0;
+            VEB->erase(x);
+        }
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    return true;
+}
+
+// floor(x) against contains: the largest key <= x is x itself or the last key before it
+template<class T>
+bool check_correctness_floor(const T* VEB, int U) {
+    int last = -1;
+    for (int x = 0; x < U; x++) {
+        if (VEB->contains(x)) last = x;
+        if (VEB->floor(x) != last) return false;
+    }
+    return true;
+}
+
+bool check_correctness(int U, int numInserted, int flags = 0, Arena* arena = nullptr) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    V* VEB = arena ? arena->make<V>(bits, flags, arena) : new V(bits, flags);
+
+    bool ok = check_correctness(VEB, U, numInserted) && check_correctness_floor(VEB, U);
+    if (!arena) delete VEB;
+    return ok;
+}
+
+// inserts and erases the same keys over and over in a LAZY tree on an arena: nodes and their
+// vectors are recycled, so the arena stops growing once every recycled node has been given
+// the vectors of each role it can take (a few rounds) and must not grow in the second half
+bool check_correctness_arena_churn(int bits, int numKeys, int rounds, int flags = V::LAZY) {
+    Arena arena;
+    V* VEB = arena.make<V>(bits, flags, &arena);
+    std::vector<int> keys(numKeys);
+    for (int& x : keys) x = rand() % (1 << bits);
+
+    size_t chunks = 0, used = 0;
+    for (int round = 0; round < rounds; round++) {
+        for (int x : keys) VEB->insert(x);
+        if ((flags & V::RANK) && (VEB->rank(VEB->max) != VEB->size - 1 || VEB->select(VEB->size - 1) != VEB->max))
+            return false;
+        for (int x : keys) VEB->erase(x);
+        if (VEB->min != -1 || VEB->summary != nullptr) return false;
+        if (round == rounds / 2) {
+            chunks = arena.chunks.size();
+            used = arena.used;
+        } else if (round > rounds / 2 && (arena.chunks.size() != chunks || arena.used != used)) {
+            return false;
+        }
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    return true;
+}
+
+bool check_correctness_flat(int U, int numInserted) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    FlatV VEB(bits);
+    return check_correctness(&VEB, U, numInserted) && check_correctness_floor(&VEB, U);
+}
+
+
+template<int Bits>
+bool check_correctness_template(int U, int numInserted) {
+    assert(U <= (1 << Bits));
+    VEB<Bits>* tree = new VEB<Bits>();
+
+    bool ok = check_correctness(tree, U, numInserted) && check_correctness_floor(tree, U);
+    delete tree;
+    return ok;
+}
+
+// unguarded inserts and erases of random keys, present or not: the return values must
+// match std::set and the tree must stay exact
+bool check_correctness_insert_erase(int U, int numOps, int flags = 0) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    V* VEB = new V(bits, flags);
+    std::set<int> s;
+
+    for (int round = 0; round < 10; round++) {
+        for (int k = 0; k < numOps; k++) {
+            int x = rand() % U;
+            bool agree = rand() % 2 ? VEB->insert(x) == s.insert(x).second : VEB->erase(x) == (s.erase(x) == 1);
+            if (!agree) return false;
+        }
+
+        for (int x = 0; x < U; x++) {
+            auto it = s.upper_bound(x);
+            if (VEB->successor(x) != (it == s.end() ? -1 : *it)) return false;
+            it = s.lower_bound(x);
+            if (VEB->predecessor(x) != (it == s.begin() ? -1 : *--it)) return false;
+            it = s.upper_bound(x);
+            if (VEB->floor(x) != (it == s.begin() ? -1 : *--it)) return false;
+        }
+        if (VEB->min != (s.empty() ? -1 : *s.begin()) || VEB->max != (s.empty() ? -1 : *s.rbegin())) return false;
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return true;
+}
+
+// rank / select / size against std::set through inserts, erases, set operations and a bulk
+// load, all of which must keep the cluster counts current
+bool check_correctness_rank(int U, int numOps, int flags = 0) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    flags |= V::RANK;
+    V* VEB = new V(bits, flags);
+    std::set<int> s;
+
+    for (int round = 0; round < 10; round++) {
+        if (round == 4 || round == 5) { // bulk load a fresh tree with the current keys
+            delete VEB;
+            VEB = new V(bits, flags);
+            std::vector<int> keys(s.begin(), s.end());
+            if (round == 4) VEB->build_from_sorted(keys.data(), keys.size());
+            else {
+                WorkerPool pool(3);
+                VEB->build_from_sorted(keys.data(), keys.size(), pool);
+            }
+        } else if (round % 3 == 2) { // combine with another tree
+            V* o = new V(bits, flags ^ V::LAZY);
+            std::set<int> t;
+            for (int k = 0; k < numOps; k++) {
+                int x = rand() % U;
+                o->insert(x);
+                t.insert(x);
+            }
+            std::set<int> r;
+            if (round == 2) {
+                VEB->unite(*o);
+                std::set_union(s.begin(), s.end(), t.begin(), t.end(), std::inserter(r, r.end()));
+            } else if (round == 8) {
+                VEB->intersect(*o);
+                std::set_intersection(s.begin(), s.end(), t.begin(), t.end(), std::inserter(r, r.end()));
+            } else {
+                VEB->subtract(*o);
+                std::set_difference(s.begin(), s.end(), t.begin(), t.end(), std::inserter(r, r.end()));
+            }
+            s.swap(r);
+            delete o;
+        }
+
+        for (int k = 0; k < numOps; k++) {
+            int x = rand() % U;
+            if (rand() % 3) {
+                VEB->insert(x);
+                s.insert(x);
+            } else {
+                VEB->erase(x);
+                s.erase(x);
+            }
+        }
+
+        if (VEB->size != (int) s.size()) return false;
+        std::vector<int> keys(s.begin(), s.end());
+        for (int x = 0; x < U; x++) {
+            if (VEB->rank(x) != std::lower_bound(keys.begin(), keys.end(), x) - keys.begin()) return false;
+        }
+        for (int k = -1; k <= (int) keys.size(); k++) {
+            if (VEB->select(k) != (k < 0 || k == (int) keys.size() ? -1 : keys[k])) return false;
+        }
+    }
+
+    // without RANK there are no counts to answer from
+    V plain(bits, flags & ~V::RANK);
+    for (int x : s) plain.insert(x);
+    if (plain.rank(U - 1) != -1 || plain.select(0) != -1) return false;
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return true;
+}
+
+// a tree filled by build_from_sorted (the parallel one on a pool of that many workers when
+// threads > 0) must answer, and keep answering after erases, exactly like one filled by inserts.
+// Half the keys (sorted or not) go into the empty tree, the other half unsorted on top of it,
+// and with RANK the counts must match too. A batch with an out of range key must be refused
+// without touching the tree.
+bool check_correctness_build(int U, int numInserted, int flags = 0, int threads = 0) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    V* a = new V(bits, flags);
+    V* b = new V(bits, flags);
+
+    std::vector<int> keys(numInserted);
+    for (int& x : keys) x = rand() % U;
+    for (int x : keys) a->insert(x);
+    size_t half = keys.size() / 2;
+    if (rand() % 2) std::sort(keys.begin(), keys.begin() + half);
+
+    WorkerPool pool(std::max(threads, 1));
+    auto build = [&](const int* k, size_t n) {
+        return threads > 0 ? b->build_from_sorted(k, n, pool) : b->build_from_sorted(k, n);
+    };
+    if (!build(keys.data(), half) || !build(keys.data() + half, keys.size() - half)) return false;
+    int bad[2] = {0, 1 << bits};
+    if (build(bad, 2) || b->contains(0) != a->contains(0)) return false;
+
+    for (int round = 0; round < 10; round++) {
+        for (int x = 0; x < U; x++) {
+            if (a->successor(x) != b->successor(x) || a->predecessor(x) != b->predecessor(x) ||
+                a->contains(x) != b->contains(x) || a->rank(x) != b->rank(x)) {
+                return false;
+            }
+        }
+
+        // remove some random elements
+        for (int i = 0; i < 20 && !keys.empty(); i++) {
+            std::swap(keys[rand() % keys.size()], keys.back());
+            if (a->erase(keys.back()) != b->erase(keys.back())) return false;
+            keys.pop_back();
+        }
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete a;
+    delete b;
+    return true;
+}
+
+// successor_batch must agree with successor on sorted, unsorted and duplicate-heavy batches
+bool check_correctness_batch(int U, int numInserted, int flags = 0) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    V* VEB = new V(bits, flags);
+
+    for (int i = 0; i < numInserted; i++) {
+        int x = rand() % U;
+        VEB->insert(x);
+    }
+
+    for (int round = 0; round < 10; round++) {
+        std::vector<int> xs(rand() % (2 * U) + 1), out(xs.size());
+        for (int& x : xs) x = round % 3 == 2 ? rand() % 16 : rand() % U;
+        if (round % 2) std::sort(xs.begin(), xs.end());
+
+        VEB->successor_batch(xs.data(), out.data(), xs.size());
+        for (size_t k = 0; k < xs.size(); k++) {
+            if (out[k] != VEB->successor(xs[k])) {
+                return false;
+            }
+        }
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return true;
+}
+
+// the pipelined engine must agree with successor for any number of queries in flight
+bool check_correctness_pipeline(int U, int numInserted, int flags = 0) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    V* VEB = new V(bits, flags);
+
+    for (int i = 0; i < numInserted; i++) {
+        int x = rand() % U;
+        VEB->insert(x);
+    }
+
+    std::vector<int> xs(U), out(U);
+    for (int x = 0; x < U; x++) xs[x] = x;
+    std::shuffle(xs.begin(), xs.end(), std::mt19937(rand()));
+
+    for (int G : {1, 3, 16}) {
+        SuccessorPipeline pipeline(VEB, G);
+        pipeline.run(xs.data(), out.data(), xs.size());
+        for (int k = 0; k < U; k++) {
+            if (out[k] != VEB->successor(xs[k])) {
+                return false;
+            }
+        }
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return true;
+}
+
+// single-threaded run of the table checker, then threads inserting and erasing their
+// own interleaved key sets concurrently while others query
+bool check_correctness_locked(int U, int numInserted, int numThreads) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    LockedV* VEB = new LockedV(bits);
+    if (!check_correctness(VEB, U, numInserted)) return false;
+    delete VEB;
+
+    VEB = new LockedV(bits);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([=]() {
+            for (int round = 0; round < 3; round++) {
+                for (int x = t; x < U; x += numThreads) VEB->insert(x);
+                for (int x = t; x < U; x += numThreads) if (x % 3 == 0) VEB->erase(x);
+                for (int x = 0; x < U; x++) VEB->successor(x);
+                for (int x = t; x < U; x += numThreads) if (x % 3 == 0) VEB->insert(x);
+            }
+            for (int x = t; x < U; x += numThreads) if (x % 2 == 0) VEB->erase(x);
+        });
+    }
+    for (std::thread& t : threads) t.join();
+
+    for (int x = 0; x < U; x++) {
+        int expected = x + 1 < U ? (x % 2 == 0 ? x + 1 : (x + 2 < U ? x + 2 : -1)) : -1;
+        if (VEB->contains(x) != (x % 2 == 1) || VEB->successor(x) != expected) {
+            return false;
+        }
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return true;
+}
+
+// many threads hammer a small, shared key range with inserts, erases and queries. Every
+// successful insert/erase is counted per key, so at the end each key must be present
+// exactly when its count is 1; concurrent queries must stay within their contract.
+bool check_correctness_atomic(int U, int numThreads, int opsPerThread) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    AtomicV* VEB = new AtomicV(bits);
+    if (!check_correctness(VEB, U, rand() % U)) return false;
+    delete VEB;
+
+    VEB = new AtomicV(bits);
+    std::vector<std::atomic<int>> net(U);
+    for (std::atomic<int>& c : net) c.store(0);
+    std::atomic<bool> ok(true);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 rng(rand() + t);
+            for (int i = 0; i < opsPerThread; i++) {
+                int x = rng() % U, op = rng() % 4;
+                if (op == 0) {
+                    if (VEB->insert(x)) net[x]++;
+                } else if (op == 1) {
+                    if (VEB->erase(x)) net[x]--;
+                } else if (op == 2) {
+                    int y = VEB->successor(x);
+                    if (y != -1 && (y <= x || y >= U)) ok = false;
+                } else {
+                    int y = VEB->predecessor(x);
+                    if (y != -1 && (y >= x || y < 0)) ok = false;
+                }
+            }
+        });
+    }
+    for (std::thread& t : threads) t.join();
+
+    std::vector<int> table(U);
+    for (int x = 0; x < U; x++) {
+        if (net[x] != 0 && net[x] != 1) return false;
+        table[x] = net[x];
+        if (VEB->contains(x) != (net[x] == 1)) return false;
+    }
+    for (int x = 0; x < U; x++) {
+        if (VEB->successor(x) != getSuccessor(table, x) || VEB->predecessor(x) != getPredecessor(table, x)) {
+            return false;
+        }
+    }
+
+    delete VEB;
+    if (!ok) return false;
+
+    // a token hops between keys in different leaves, inserted at its new key before it is
+    // erased from the old one, so one of those keys is always present and successor(0) /
+    // predecessor(U - 1) must always find it: a query that saw the leaves at different times
+    // could miss the token when it jumps behind the query, and find nothing
+    int spots = std::min(8, U / 4); // keys in [2, U - 2]
+    if (spots < 2) return ok;
+    std::vector<int> key(spots);
+    for (int k = 0; k < spots; k++) key[k] = (2 * k + 1) * U / (2 * spots);
+
+    VEB = new AtomicV(bits);
+    VEB->insert(key[0]);
+    std::atomic<bool> moving(true);
+
+    threads.clear();
+    threads.emplace_back([&]() {
+        std::mt19937 rng(rand());
+        for (int i = 0, at = 0; i < opsPerThread; i++) {
+            int to = rng() % spots;
+            if (to == at) continue;
+            VEB->insert(key[to]);
+            VEB->erase(key[at]);
+            at = to;
+        }
+        moving = false;
+    });
+    for (int t = 1; t < numThreads; t++) {
+        threads.emplace_back([&]() {
+            while (moving) {
+                if (VEB->successor(0) == -1 || VEB->predecessor(U - 1) == -1) ok = false;
+            }
+        });
+    }
+    for (std::thread& t : threads) t.join();
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return ok;
+}
+
+// table checker on SnapshotV, then readers that take a snapshot and verify it stays
+// exactly the set it was when taken while a writer keeps changing the tree
+bool check_correctness_snapshot(int U, int numInserted, int numReaders) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    SnapshotV* VEB = new SnapshotV(bits);
+    if (!check_correctness(VEB, U, numInserted) || !check_correctness_floor(VEB, U)) return false;
+    delete VEB;
+
+    VEB = new SnapshotV(bits);
+    std::mutex history_lock;
+    std::vector<std::vector<int>> history; // history[v] = sorted keys after the v-th write
+    history.emplace_back();
+    std::atomic<bool> done(false), ok(true);
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < numReaders; t++) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                SnapshotV::Snapshot snap = VEB->snapshot();
+                std::vector<int> keys;
+                for (int x = snap.contains(0) ? 0 : snap.successor(0); x != -1; x = snap.successor(x)) keys.push_back(x);
+
+                // the snapshot must equal one of the published versions, and not change
+                std::vector<int> again;
+                for (int x = snap.contains(0) ? 0 : snap.successor(0); x != -1; x = snap.successor(x)) again.push_back(x);
+                std::lock_guard<std::mutex> guard(history_lock);
+                if (keys != again || std::find(history.begin(), history.end(), keys) == history.end()) ok = false;
+            }
+        });
+    }
+
+    std::set<int> current;
+    std::mt19937 rng(rand());
+    for (int i = 0; i < 20 * numInserted; i++) {
+        int x = rng() % U;
+        std::lock_guard<std::mutex> guard(history_lock); // publish and record together
+        if (current.count(x)) VEB->erase(x), current.erase(x);
+        else VEB->insert(x), current.insert(x);
+        history.emplace_back(current.begin(), current.end());
+    }
+    done = true;
+    for (std::thread& t : readers) t.join();
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return ok;
+}
+
+// table checker on ShardedV through the single-key operations, then batched operations
+// checked against a plain V fed the same keys
+bool check_correctness_sharded(int U, int numInserted, int shards) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    bits = std::max(bits, __builtin_ctz(shards));
+
+    ShardedV* VEB = new ShardedV(bits, shards);
+    if (!check_correctness(VEB, U, numInserted)) return false;
+    delete VEB;
+
+    VEB = new ShardedV(bits, shards);
+    V* plain = new V(bits);
+    for (int round = 0; round < 10; round++) {
+        std::vector<int> keys(numInserted), out(U), xs(U);
+        for (int& x : keys) x = rand() % U;
+        for (int x = 0; x < U; x++) xs[x] = x;
+
+        if (round % 2 == 0) {
+            VEB->insert_batch(keys.data(), keys.size());
+            for (int x : keys) plain->insert(x);
+        } else {
+            VEB->erase_batch(keys.data(), keys.size());
+            for (int x : keys) plain->erase(x);
+        }
+
+        VEB->successor_batch(xs.data(), out.data(), xs.size());
+        for (int x = 0; x < U; x++) {
+            if (out[x] != plain->successor(x) || VEB->predecessor(x) != plain->predecessor(x)) {
+                return false;
+            }
+        }
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    delete plain;
+    return true;
+}
+
+// unite / intersect / subtract of two random trees, in place and into new trees, checked
+// against the same operations on std::set (trees compared key by key with the table checker);
+// operands over different universes must be refused
+bool check_correctness_set_operations(int U, int numInserted, int flags = 0) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    for (int round = 0; round < 20; round++) {
+        V* a = new V(bits, flags);
+        V* b = new V(bits, flags ^ V::LAZY); // mix layouts
+        std::set<int> sa, sb;
+        for (int k = 0; k < numInserted; k++) {
+            int x = rand() % U, y = round % 2 ? x ^ rand() % 4 : rand() % U; // overlapping sets on odd rounds
+            if (y >= U) y = x;
+            if (sa.insert(x).second) a->insert(x);
+            if (sb.insert(y).second) b->insert(y);
+        }
+
+        std::set<int> expected[3];
+        std::set_union(sa.begin(), sa.end(), sb.begin(), sb.end(), std::inserter(expected[0], expected[0].end()));
+        std::set_intersection(sa.begin(), sa.end(), sb.begin(), sb.end(), std::inserter(expected[1], expected[1].end()));
+        std::set_difference(sa.begin(), sa.end(), sb.begin(), sb.end(), std::inserter(expected[2], expected[2].end()));
+
+        V* got[6] = {unite(*a, *b, flags), intersect(*a, *b, flags), subtract(*a, *b, flags),
+                     unite(*a, *b, flags), unite(*a, *b, flags), unite(*a, *b, flags)};
+        for (int k = 3; k < 6; k++) { // got[k] = a, then the operation in place
+            got[k]->intersect(*a);
+            if (k == 3) got[k]->unite(*b);
+            if (k == 4) got[k]->intersect(*b);
+            if (k == 5) got[k]->subtract(*b);
+        }
+
+        for (int k = 0; k < 6; k++) {
+            const std::set<int>& e = expected[k % 3];
+            for (int x = 0; x < U; x++) {
+                auto it = e.upper_bound(x);
+                int succ = it == e.end() ? -1 : *it;
+                it = e.lower_bound(x);
+                int pred = it == e.begin() ? -1 : *--it;
+                if (got[k]->successor(x) != succ || got[k]->predecessor(x) != pred ||
+                    got[k]->contains(x) != (e.count(x) > 0)) {
+                    return false;
+                }
+            }
+            int lo = e.empty() ? -1 : *e.begin(), hi = e.empty() ? -1 : *e.rbegin();
+            if (got[k]->min != lo || got[k]->max != hi) return false;
+            delete got[k];
+        }
+
+        // a tree over another universe is refused and leaves a as it was
+        V other(bits + 1, flags);
+        other.insert(0);
+        other.insert((2 << bits) - 1);
+        int before = a->size;
+        if (a->unite(other) || a->intersect(other) || a->subtract(other) || other.unite(*a) ||
+            unite(*a, other) != nullptr || intersect(other, *a) != nullptr || subtract(*a, other) != nullptr ||
+            a->size != before || other.size != 2) {
+            return false;
+        }
+        delete a;
+        delete b;
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    return true;
+}
+
+// VEBMap<std::string> against std::map under random inserts and erases: every query must
+// return the same key and the same payload
+bool check_correctness_map(int U, int numInserted) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    VEBMap<std::string>* VEB = new VEBMap<std::string>(bits);
+    std::map<int, std::string> m;
+
+    for (int round = 0; round < 10; round++) {
+        for (int k = 0; k < numInserted; k++) {
+            int x = rand() % U;
+            if (rand() % 3 == 0) {
+                if (m.erase(x)) VEB->erase(x);
+            } else if (!m.count(x)) {
+                m[x] = std::to_string(x) + "#" + std::to_string(rand());
+                VEB->insert(x, m[x]);
+            }
+        }
+
+        for (int x = 0; x < U; x++) {
+            std::string* v = nullptr;
+            auto it = m.upper_bound(x);
+            int y = VEB->successor(x, v);
+            if (it == m.end() ? y != -1 : y != it->first || *v != it->second) return false;
+
+            it = m.lower_bound(x);
+            y = VEB->predecessor(x, v);
+            if (it == m.begin() ? y != -1 : y != (--it)->first || *v != it->second) return false;
+
+            it = m.upper_bound(x);
+            y = VEB->floor(x, v);
+            if (it == m.begin() ? y != -1 : y != (--it)->first || *v != it->second) return false;
+
+            it = m.find(x);
+            v = VEB->find(x);
+            if (it == m.end() ? v != nullptr : v == nullptr || *v != it->second) return false;
+            if (VEB->contains(x) != (it != m.end())) return false;
+        }
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return true;
+}
+
+// VEBMultiset against std::multiset with many repeated keys, then the table checker
+bool check_correctness_multiset(int U, int numInserted) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    VEBMultiset* VEB = new VEBMultiset(bits);
+    std::multiset<int> m;
+
+    for (int round = 0; round < 10; round++) {
+        for (int k = 0; k < numInserted; k++) {
+            int x = rand() % U;
+            if (rand() % 2 == 0) {
+                auto it = m.find(x);
+                if (VEB->erase(x) != (it != m.end())) return false;
+                if (it != m.end()) m.erase(it);
+            } else {
+                VEB->insert(x);
+                m.insert(x);
+            }
+        }
+
+        if (VEB->size() != (long long) m.size()) return false;
+        for (int x = 0; x < U; x++) {
+            auto it = m.upper_bound(x);
+            if (VEB->successor(x) != (it == m.end() ? -1 : *it)) return false;
+            it = m.lower_bound(x);
+            if (VEB->predecessor(x) != (it == m.begin() ? -1 : *--it)) return false;
+            if (VEB->count(x) != (int) m.count(x)) return false;
+        }
+    }
+    delete VEB;
+
+    VEB = new VEBMultiset(bits);
+    if (!check_correctness(VEB, U, numInserted)) return false;
+    delete VEB;
+    return true;
+}
+
+// random push / pop_min / decrease_key / erase on VEBPriorityQueue against a std::set of
+// (priority, item) pairs; ties may be broken differently, so only priorities are compared
+bool check_correctness_priority_queue(int U, int numItems, int numOps) {
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    VEBPriorityQueue* pq = new VEBPriorityQueue(bits, numItems);
+    std::set<std::pair<int, int>> s;
+    std::vector<int> p(numItems, -1);
+
+    for (int k = 0; k < numOps; k++) {
+        int item = rand() % numItems, op = rand() % 4;
+        if (p[item] == -1) { // push, with few distinct priorities half of the time
+            p[item] = k % 2 ? rand() % U : rand() % 4;
+            pq->push(item, p[item]);
+            s.insert({p[item], item});
+        } else if (op == 0 && !s.empty()) {
+            int top = pq->pop_min();
+            if (p[top] != s.begin()->first || !s.erase({p[top], top})) return false;
+            p[top] = -1;
+        } else if (op == 1) {
+            int q = rand() % (p[item] + 1);
+            pq->decrease_key(item, q);
+            s.erase({p[item], item});
+            s.insert({p[item] = q, item});
+        } else if (op == 2) {
+            pq->erase(item);
+            s.erase({p[item], item});
+            p[item] = -1;
+        }
+
+        if (pq->size() != (int) s.size()) return false;
+        if (!s.empty() && (pq->top_priority() != s.begin()->first || pq->priority(pq->top()) != s.begin()->first)) {
+            return false;
+        }
+        if (pq->contains(item) != (p[item] != -1)) return false;
+    }
+
+    while (!s.empty()) {
+        int top = pq->pop_min();
+        if (p[top] != s.begin()->first || !s.erase({p[top], top})) return false;
+    }
+    if (!pq->empty()) return false;
+
+    std::cout << "All tests passed!" << std::endl;
+    delete pq;
+    return true;
+}
+
+// checks V64 against std::set on full-range 64-bit keys, plus a dense run of keys
+// so that the leaves and small clusters get exercised too
+bool check_correctness_V64(int numInserted, int numQueries) {
+    std::mt19937_64 rng(rand());
+    V64* VEB = new V64();
+    std::set<uint64_t> s;
+
+    uint64_t base = rng();
+    for (int i = 0; i < numInserted; i++) {
+        uint64_t x = i % 2 ? rng() : base + rng() % (4 * numInserted + 1);
+        if (!VEB->contains(x))
+            VEB->insert(x);
+        s.insert(x);
+    }
+    VEB->insert(0), s.insert(0);
+    VEB->insert(~0ULL), s.insert(~0ULL);
+
+    for (int round = 0; round < 10; round++) {
+        for (int q = 0; q < numQueries; q++) {
+            uint64_t x = q % 2 ? rng() : base + rng() % (4 * numInserted + 1), y;
+
+            auto it = s.upper_bound(x);
+            bool found = VEB->successor(x, y);
+            if (found != (it != s.end()) || (found && y != *it)) return false;
+
+            it = s.lower_bound(x);
+            found = VEB->predecessor(x, y);
+            if (found != (it != s.begin()) || (found && y != *std::prev(it))) return false;
+
+            it = s.upper_bound(x);
+            found = VEB->floor(x, y);
+            if (found != (it != s.begin()) || (found && y != *std::prev(it))) return false;
+
+            if (VEB->contains(x) != (s.count(x) == 1)) return false;
+        }
+
+        // remove some random elements
+        for (int i = 0; i < numInserted / 10 && !s.empty(); i++) {
+            auto it = s.lower_bound(rng());
+            if (it == s.end()) it = s.begin();
+            VEB->erase(*it);
+            s.erase(it);
+        }
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return true;
+}
+
+long long check_performance_BST(int U, int insertions, int erases, int successors, int predecessors = 0) {
+    long long ans = 0;
+
+    ordered_set s;
+
+    for (int i = 0; i < insertions; i++) {
+        int x = rand() % (U - 1) + 1;
+        s.insert(x);
+    }
+
+    for (int i = 0; i < erases; i++) {
+        s.erase(rand() % U);
+    }
+
+    for (int i = 0; i < successors; i++) {
+        int ord = s.order_of_key(rand() % U);
+        if (ord < (int) s.size() - 1) {
+            ans += *s.find_by_order(ord + 1); // next biggest element
+        } else {
+            ans += -1;
+        }
+    }
+
+    for (int i = 0; i < predecessors; i++) {
+        int ord = s.order_of_key(rand() % U);
+        if (ord > 0) {
+            ans += *s.find_by_order(ord - 1); // next smallest element
+        } else {
+            ans += -1;
+        }
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    return ans;
+}
+
+long long check_performance_VEB(int U, int insertions, int erases, int successors, int predecessors = 0, int flags = 0) {
+    long long ans = 0;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    V* VEB = new V(bits, flags);
+
+    for (int i = 0; i < insertions; i++) {
+        int x = rand() % U;
+        VEB->insert(x);
+    }
+
+    for (int i = 0; i < erases; i++) {
+        VEB->erase(rand() % U);
+    }
+
+    for (int i = 0; i < successors; i++) {
+        ans += VEB->successor(rand() % U);
+    }
+
+    for (int i = 0; i < predecessors; i++) {
+        ans += VEB->predecessor(rand() % U);
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return ans;
+}
+
+long long check_performance_FlatVEB(int U, int insertions, int erases, int successors, int predecessors = 0) {
+    long long ans = 0;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    FlatV* VEB = new FlatV(bits);
+
+    for (int i = 0; i < insertions; i++) {
+        int x = rand() % U;
+        if (!VEB->contains(x))
+            VEB->insert(x);
+    }
+
+    for (int i = 0; i < erases; i++) {
+        VEB->erase(rand() % U);
+    }
+
+    for (int i = 0; i < successors; i++) {
+        ans += VEB->successor(rand() % U);
+    }
+
+    for (int i = 0; i < predecessors; i++) {
+        ans += VEB->predecessor(rand() % U);
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return ans;
+}
+
+// same workload as check_performance_VEB on the compile-time VEB<Bits>, U <= 2^Bits
+template<int Bits>
+long long check_performance_TemplateVEB(int U, int insertions, int erases, int successors, int predecessors = 0) {
+    long long ans = 0;
+
+    assert(U <= (1 << Bits));
+    VEB<Bits>* tree = new VEB<Bits>();
+
+    for (int i = 0; i < insertions; i++) {
+        int x = rand() % U;
+        if (!tree->contains(x))
+            tree->insert(x);
+    }
+
+    for (int i = 0; i < erases; i++) {
+        tree->erase(rand() % U);
+    }
+
+    for (int i = 0; i < successors; i++) {
+        ans += tree->successor(rand() % U);
+    }
+
+    for (int i = 0; i < predecessors; i++) {
+        ans += tree->predecessor(rand() % U);
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete tree;
+    return ans;
+}
+
+// compares seeding a tree with n random keys by repeated inserts (in random and in sorted
+// order) against build_from_sorted; keys are generated and sorted before any clock starts
+void check_performance_build(int U, int n, int flags = 0) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    std::vector<int> keys(n);
+    for (int& x : keys) x = rand() % U;
+    std::vector<int> sorted = keys;
+    std::sort(sorted.begin(), sorted.end());
+
+    V* VEB[3];
+    double seconds[3];
+    for (int k = 0; k < 3; k++) {
+        VEB[k] = new V(bits, flags);
+        auto t0 = clock::now();
+        if (k == 2) {
+            VEB[k]->build_from_sorted(sorted.data(), sorted.size());
+        } else {
+            for (int x : k == 0 ? keys : sorted) VEB[k]->insert(x);
+        }
+        seconds[k] = std::chrono::duration<double>(clock::now() - t0).count();
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < 1000000; i++) {
+        int x = rand() % U;
+        mismatches += VEB[0]->successor(x) != VEB[2]->successor(x);
+    }
+
+    std::cout << "random inserts:    " << seconds[0] << "s" << std::endl;
+    std::cout << "sorted inserts:    " << seconds[1] << "s" << std::endl;
+    std::cout << "build_from_sorted: " << seconds[2] << "s" << std::endl;
+    if (mismatches) std::cout << mismatches << " successor mismatches!" << std::endl;
+    for (V* v : VEB) delete v;
+}
+
+// scalar successor loop vs successor_batch, on batches of batchSize queries that are
+// pre-generated before the clock starts, both unsorted and sorted
+void check_performance_successor_batch(int U, int insertions, int successors, int batchSize) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    V* VEB = new V(bits);
+    for (int i = 0; i < insertions; i++) {
+        int x = rand() % U;
+        VEB->insert(x);
+    }
+
+    std::vector<int> xs(successors), out(successors);
+    for (int& x : xs) x = rand() % U;
+
+    for (int sorted = 0; sorted < 2; sorted++) {
+        if (sorted)
+            for (int k = 0; k < successors; k += batchSize)
+                std::sort(xs.begin() + k, xs.begin() + std::min(k + batchSize, successors));
+
+        long long ans[2] = {0, 0};
+        auto t0 = clock::now();
+        for (int k = 0; k < successors; k++) ans[0] += VEB->successor(xs[k]);
+        auto t1 = clock::now();
+        for (int k = 0; k < successors; k += batchSize)
+            VEB->successor_batch(&xs[k], &out[k], std::min(batchSize, successors - k));
+        for (int k = 0; k < successors; k++) ans[1] += out[k];
+        auto t2 = clock::now();
+
+        std::cout << (sorted ? "sorted batches:   " : "unsorted batches: ")
+                  << "scalar " << std::chrono::duration<double>(t1 - t0).count() << "s, "
+                  << "batch " << std::chrono::duration<double>(t2 - t1).count() << "s"
+                  << (ans[0] == ans[1] ? "" : " (answers differ!)") << std::endl;
+    }
+
+    delete VEB;
+}
+
+// scalar successor loop vs SuccessorPipeline with G queries in flight, on the tree and
+// query mix of check_performance_VEB; queries are generated before the clock starts.
+// L1D and LLC misses per query come from PerfCounters, n/a where a counter cannot be opened
+void check_performance_pipeline(int U, int insertions, int successors) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+    V* VEB = new V(bits);
+    for (int i = 0; i < insertions; i++) {
+        int x = rand() % U;
+        VEB->insert(x);
+    }
+
+    std::vector<int> xs(successors), out(successors);
+    for (int& x : xs) x = rand() % U;
+
+    PerfCounters perf;
+    double events[PerfCounters::EVENTS];
+    auto misses = [&]() {
+        for (int e : {PerfCounters::L1D_MISSES, PerfCounters::LLC_MISSES}) {
+            std::cout << ", ";
+            if (events[e] == -1) std::cout << "n/a";
+            else std::cout << events[e];
+            std::cout << (e == PerfCounters::L1D_MISSES ? " L1D" : " LLC misses/query");
+        }
+    };
+
+    long long expected = 0;
+    perf.start();
+    auto t0 = clock::now();
+    for (int x : xs) expected += VEB->successor(x);
+    double scalar = std::chrono::duration<double>(clock::now() - t0).count();
+    perf.stop(successors, events);
+    std::cout << "scalar:      " << successors / scalar / 1e6 << " M queries/s";
+    misses();
+    std::cout << std::endl;
+
+    for (int G : {1, 2, 4, 8, 16, 32, 64}) {
+        SuccessorPipeline pipeline(VEB, G);
+        perf.start();
+        t0 = clock::now();
+        pipeline.run(xs.data(), out.data(), successors);
+        double seconds = std::chrono::duration<double>(clock::now() - t0).count();
+        perf.stop(successors, events);
+
+        long long ans = 0;
+        for (int y : out) ans += y;
+        std::cout << "pipeline G=" << G << ": " << successors / seconds / 1e6 << " M queries/s";
+        misses();
+        std::cout << ", " << (double) pipeline.loads / successors << " prefetched loads/query"
+                  << (ans == expected ? "" : " (answers differ!)") << std::endl;
+    }
+
+    delete VEB;
+}
+
+// 90% successor / 5% insert / 5% erase from 1..maxThreads threads, LockedV and AtomicV
+// against one V behind a single mutex; prints total and read throughput per thread count
+void check_performance_concurrent(int U, int insertions, int opsPerThread, int maxThreads) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    LockedV* locked = new LockedV(bits);
+    AtomicV* atomic = new AtomicV(bits);
+    V* plain = new V(bits);
+    std::mutex global;
+    std::atomic<long long> sink(0); // keeps the queries from being optimised away
+    for (int i = 0; i < insertions; i++) {
+        int x = rand() % U;
+        locked->insert(x);
+        atomic->insert(x);
+        plain->insert(x);
+    }
+
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        for (int engine = 0; engine < 3; engine++) {
+            std::vector<std::thread> pool;
+            auto t0 = clock::now();
+            for (int t = 0; t < threads; t++) {
+                pool.emplace_back([&, t]() {
+                    std::mt19937 rng(t * 7919 + engine);
+                    long long ans = 0;
+                    for (int i = 0; i < opsPerThread; i++) {
+                        int x = rng() % U, op = rng() % 20;
+                        if (engine == 0) {
+                            if (op == 0) locked->insert(x);
+                            else if (op == 1) locked->erase(x);
+                            else ans += locked->successor(x);
+                        } else if (engine == 1) {
+                            if (op == 0) atomic->insert(x);
+                            else if (op == 1) atomic->erase(x);
+                            else ans += atomic->successor(x);
+                        } else {
+                            std::lock_guard<std::mutex> guard(global);
+                            if (op == 0) plain->insert(x);
+                            else if (op == 1) plain->erase(x);
+                            else ans += plain->successor(x);
+                        }
+                    }
+                    sink += ans;
+                });
+            }
+            for (std::thread& t : pool) t.join();
+            double seconds = std::chrono::duration<double>(clock::now() - t0).count();
+
+            const char* name[3] = {"LockedV     ", "AtomicV     ", "V + mutex   "};
+            std::cout << name[engine] << threads << " threads: "
+                      << threads * (double) opsPerThread / seconds / 1e6 << " M ops/s, "
+                      << threads * 0.9 * opsPerThread / seconds / 1e6 << " M reads/s" << std::endl;
+        }
+    }
+
+    delete locked;
+    delete atomic;
+    delete plain;
+}
+
+// latency of single writes while numReaders threads keep scanning the whole set with
+// successor: SnapshotV, where scans run on snapshots, against a V behind a reader-writer
+// lock that each scan holds for its whole duration. Readers rest 1ms between scans and
+// writes arrive every 100us, so the locked writer is delayed but not starved outright.
+void check_performance_snapshot(int U, int insertions, int writes, int numReaders) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    for (int engine = 0; engine < 2; engine++) {
+        SnapshotV* snapshots = new SnapshotV(bits);
+        V* plain = new V(bits);
+        std::shared_mutex rw;
+
+        for (int i = 0; i < insertions; i++) {
+            int x = rand() % U;
+            if (engine == 0) snapshots->insert(x);
+            else plain->insert(x);
+        }
+
+        std::atomic<bool> done(false);
+        std::atomic<long long> scans(0);
+        std::vector<std::thread> readers;
+        for (int t = 0; t < numReaders; t++) {
+            readers.emplace_back([&]() {
+                while (!done) {
+                    long long n = 0;
+                    if (engine == 0) {
+                        SnapshotV::Snapshot snap = snapshots->snapshot();
+                        for (int x = snap.successor(0); x != -1; x = snap.successor(x)) n++;
+                    } else {
+                        std::shared_lock<std::shared_mutex> guard(rw);
+                        for (int x = plain->successor(0); x != -1; x = plain->successor(x)) n++;
+                    }
+                    scans += n > 0;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            });
+        }
+
+        std::vector<double> latency;
+        std::mt19937 rng(rand());
+        for (int i = 0; i < writes; i++) {
+            int x = rng() % U;
+            auto t0 = clock::now();
+            if (engine == 0) {
+                if (!snapshots->insert(x)) snapshots->erase(x);
+            } else {
+                std::unique_lock<std::shared_mutex> guard(rw);
+                if (!plain->insert(x)) plain->erase(x);
+            }
+            latency.push_back(std::chrono::duration<double, std::micro>(clock::now() - t0).count());
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        done = true;
+        for (std::thread& t : readers) t.join();
+
+        std::sort(latency.begin(), latency.end());
+        std::cout << (engine == 0 ? "SnapshotV:  " : "V + rwlock: ") << "write latency p50 " << latency[writes / 2]
+                  << "us, p99 " << latency[writes * 99 / 100] << "us, max " << latency.back() << "us ("
+                  << scans << " full scans)" << std::endl;
+
+        delete snapshots;
+        delete plain;
+    }
+}
+
+// batched insert / erase / successor throughput of ShardedV for 1, 2, 4, ... maxShards
+// shards (one worker thread each); keys are generated before the clock starts
+void check_performance_sharded(int U, int operations, int maxShards) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    std::vector<int> keys(operations), out(operations);
+    for (int& x : keys) x = rand() % U;
+
+    for (int shards = 1; shards <= maxShards; shards *= 2) {
+        ShardedV* VEB = new ShardedV(bits, shards);
+
+        auto t0 = clock::now();
+        VEB->insert_batch(keys.data(), keys.size());
+        auto t1 = clock::now();
+        VEB->successor_batch(keys.data(), out.data(), keys.size());
+        auto t2 = clock::now();
+        VEB->erase_batch(keys.data(), keys.size());
+        auto t3 = clock::now();
+
+        std::cout << shards << " shards: insert " << operations / std::chrono::duration<double>(t1 - t0).count() / 1e6
+                  << " M/s, successor " << operations / std::chrono::duration<double>(t2 - t1).count() / 1e6
+                  << " M/s, erase " << operations / std::chrono::duration<double>(t3 - t2).count() / 1e6
+                  << " M/s" << std::endl;
+        delete VEB;
+    }
+}
+
+// serial build_from_sorted against the parallel build on 1, 2, 4, ... maxThreads workers;
+// the pool is started and the keys sorted before any clock starts
+void check_performance_build_parallel(int U, int n, int maxThreads, int flags = 0) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    std::vector<int> keys(n);
+    for (int& x : keys) x = rand() % U;
+    std::sort(keys.begin(), keys.end());
+
+    V* serial = new V(bits, flags);
+    auto t0 = clock::now();
+    serial->build_from_sorted(keys.data(), keys.size());
+    std::cout << "serial:     " << std::chrono::duration<double>(clock::now() - t0).count() << "s" << std::endl;
+
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        WorkerPool pool(threads);
+        V* VEB = new V(bits, flags);
+        t0 = clock::now();
+        VEB->build_from_sorted(keys.data(), keys.size(), pool);
+        double seconds = std::chrono::duration<double>(clock::now() - t0).count();
+
+        int mismatches = 0;
+        for (int i = 0; i < 1000000; i++) {
+            int x = rand() % U;
+            mismatches += serial->successor(x) != VEB->successor(x);
+        }
+
+        std::cout << threads << " threads:  " << seconds << "s" << std::endl;
+        if (mismatches) std::cout << mismatches << " successor mismatches!" << std::endl;
+        delete VEB;
+    }
+    delete serial;
+}
+
+// intersection of two random trees of n keys each: walking a with successor and probing b
+// with contains, against V::intersect on a copy of a (the copy is made before the clock)
+void check_performance_intersect(int U, int n, int flags = 0) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    V* a = new V(bits, flags);
+    V* b = new V(bits, flags);
+    for (int k = 0; k < n; k++) {
+        int x = rand() % U, y = rand() % U;
+        a->insert(x);
+        b->insert(y);
+    }
+
+    auto t0 = clock::now();
+    V* probed = new V(bits, flags);
+    for (int x = a->min; x != -1; x = a->successor(x))
+        if (b->contains(x))
+            probed->insert(x);
+    auto t1 = clock::now();
+
+    V* copy = new V(bits, flags);
+    copy->unite(*a);
+    auto t2 = clock::now();
+    copy->intersect(*b);
+    auto t3 = clock::now();
+
+    int mismatches = 0;
+    for (int i = 0; i < 1000000; i++) {
+        int x = rand() % U;
+        mismatches += probed->successor(x) != copy->successor(x);
+    }
+
+    std::cout << "successor + contains: " << std::chrono::duration<double>(t1 - t0).count() << "s" << std::endl;
+    std::cout << "intersect in place:   " << std::chrono::duration<double>(t3 - t2).count() << "s" << std::endl;
+    if (mismatches) std::cout << mismatches << " successor mismatches!" << std::endl;
+    delete a;
+    delete b;
+    delete probed;
+    delete copy;
+}
+
+// key -> payload maps under the check_performance_VEB workload, every successor query also
+// reading its payload: VEBMap, a V next to an unordered_map (two lookups per query),
+// std::map and the pbds tree. Keys are generated before any clock starts
+void check_performance_map(int U, int insertions, int erases, int successors) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    std::vector<int> ins(insertions), er(erases), succ(successors);
+    for (int& x : ins) x = rand() % U;
+    for (int& x : er) x = rand() % U;
+    for (int& x : succ) x = rand() % U;
+
+    long long ans[4] = {0, 0, 0, 0};
+    double seconds[4];
+    auto t0 = clock::now();
+    {
+        VEBMap<int> m(bits);
+        for (int x : ins) if (!m.contains(x)) m.insert(x, x ^ 1);
+        for (int x : er) if (m.contains(x)) m.erase(x);
+        for (int x : succ) {
+            int* v;
+            if (m.successor(x, v) != -1) ans[0] += *v;
+        }
+    }
+    seconds[0] = std::chrono::duration<double>(clock::now() - t0).count();
+
+    t0 = clock::now();
+    {
+        V set(bits, V::LAZY);
+        std::unordered_map<int, int> values;
+        for (int x : ins) if (set.insert(x)) values[x] = x ^ 1;
+        for (int x : er) if (set.erase(x)) values.erase(x);
+        for (int x : succ) {
+            int y = set.successor(x);
+            if (y != -1) ans[1] += values[y];
+        }
+    }
+    seconds[1] = std::chrono::duration<double>(clock::now() - t0).count();
+
+    t0 = clock::now();
+    {
+        std::map<int, int> m;
+        for (int x : ins) m.emplace(x, x ^ 1);
+        for (int x : er) m.erase(x);
+        for (int x : succ) {
+            auto it = m.upper_bound(x);
+            if (it != m.end()) ans[2] += it->second;
+        }
+    }
+    seconds[2] = std::chrono::duration<double>(clock::now() - t0).count();
+
+    t0 = clock::now();
+    {
+        ordered_map m;
+        for (int x : ins) m.insert(std::make_pair(x, x ^ 1));
+        for (int x : er) m.erase(x);
+        for (int x : succ) {
+            auto it = m.upper_bound(x);
+            if (it != m.end()) ans[3] += it->second;
+        }
+    }
+    seconds[3] = std::chrono::duration<double>(clock::now() - t0).count();
+
+    std::cout << "VEBMap:            " << seconds[0] << "s" << std::endl;
+    std::cout << "V + unordered_map: " << seconds[1] << "s" << std::endl;
+    std::cout << "std::map:          " << seconds[2] << "s" << std::endl;
+    std::cout << "pbds tree:         " << seconds[3] << "s" << std::endl;
+    if (ans[0] != ans[1] || ans[0] != ans[2] || ans[0] != ans[3]) std::cout << "payload sums differ!" << std::endl;
+}
+
+// n inserts with about `copies` copies of each key, then n erases and n successor queries:
+// VEBMultiset against std::multiset. Keys are generated before any clock starts
+void check_performance_multiset(int U, int n, int copies) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    std::vector<int> distinct(std::max(1, n / copies)), ins(n), er(n), succ(n);
+    for (int& x : distinct) x = rand() % U;
+    for (int& x : ins) x = distinct[rand() % distinct.size()];
+    for (int& x : er) x = distinct[rand() % distinct.size()];
+    for (int& x : succ) x = rand() % U;
+
+    long long ans[2] = {0, 0};
+    auto t0 = clock::now();
+    {
+        VEBMultiset m(bits);
+        for (int x : ins) m.insert(x);
+        for (int x : er) m.erase(x);
+        for (int x : succ) ans[0] += m.successor(x);
+    }
+    auto t1 = clock::now();
+    {
+        std::multiset<int> m;
+        for (int x : ins) m.insert(x);
+        for (int x : er) {
+            auto it = m.find(x);
+            if (it != m.end()) m.erase(it);
+        }
+        for (int x : succ) {
+            auto it = m.upper_bound(x);
+            ans[1] += it == m.end() ? -1 : *it;
+        }
+    }
+    auto t2 = clock::now();
+
+    std::cout << "VEBMultiset:    " << std::chrono::duration<double>(t1 - t0).count() << "s" << std::endl;
+    std::cout << "std::multiset:  " << std::chrono::duration<double>(t2 - t1).count() << "s" << std::endl;
+    if (ans[0] != ans[1]) std::cout << "successor sums differ!" << std::endl;
+}
+
+// Monotone min-heap of (key, item) pairs for the Dijkstra benchmark: bucket i holds keys whose
+// highest bit differing from the last popped key is bit i-1, and a pop only redistributes
+// the first non-empty bucket once bucket 0 runs out.
+struct RadixHeap {
+    std::vector<std::pair<uint32_t, int>> bucket[33];
+    uint32_t last = 0;
+    size_t count = 0;
+
+    int bucket_of(uint32_t key) const { return key == last ? 0 : 32 - __builtin_clz(key ^ last); }
+    bool empty() const { return count == 0; }
+
+    void push(uint32_t key, int item) {
+        bucket[bucket_of(key)].push_back({key, item});
+        count++;
+    }
+
+    std::pair<uint32_t, int> pop() {
+        if (bucket[0].empty()) {
+            int i = 1;
+            while (bucket[i].empty()) i++;
+            last = std::min_element(bucket[i].begin(), bucket[i].end())->first;
+            for (auto& e : bucket[i]) bucket[bucket_of(e.first)].push_back(e);
+            bucket[i].clear();
+        }
+        auto e = bucket[0].back();
+        bucket[0].pop_back();
+        count--;
+        return e;
+    }
+};
+
+// Dijkstra from vertex 0 on a random directed graph with n vertices, m edges and weights in
+// [1, maxWeight]: VEBPriorityQueue with decrease_key against std::priority_queue and a radix
+// heap, both with lazy deletion. The graph is generated (as adjacency arrays) before any clock starts
+void check_performance_dijkstra(int n, int m, int maxWeight) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1LL << bits) <= (long long) (n - 1) * maxWeight) ++bits;
+    assert(bits <= 30);
+
+    std::vector<int> start(n + 1), to(m), weight(m);
+    std::vector<std::pair<int, int>> edges(m);
+    for (auto& e : edges) e = {rand() % n, rand() % n};
+    std::sort(edges.begin(), edges.end());
+    for (int k = 0; k < m; k++) {
+        start[edges[k].first + 1]++;
+        to[k] = edges[k].second;
+        weight[k] = 1 + rand() % maxWeight;
+    }
+    for (int u = 0; u < n; u++) start[u + 1] += start[u];
+
+    std::vector<int> dist[3];
+    double seconds[3];
+    for (int engine = 0; engine < 3; engine++) {
+        std::vector<int>& d = dist[engine];
+        d.assign(n, INT32_MAX);
+        d[0] = 0;
+
+        auto t0 = clock::now();
+        if (engine == 0) {
+            VEBPriorityQueue pq(bits, n);
+            pq.push(0, 0);
+            while (!pq.empty()) {
+                int u = pq.pop_min();
+                for (int k = start[u]; k < start[u + 1]; k++) {
+                    int v = to[k], dv = d[u] + weight[k];
+                    if (dv >= d[v]) continue;
+                    if (pq.contains(v)) pq.decrease_key(v, dv);
+                    else pq.push(v, dv);
+                    d[v] = dv;
+                }
+            }
+        } else if (engine == 1) {
+            std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<>> pq;
+            pq.push({0, 0});
+            while (!pq.empty()) {
+                auto [du, u] = pq.top();
+                pq.pop();
+                if (du != d[u]) continue; // stale entry
+                for (int k = start[u]; k < start[u + 1]; k++) {
+                    int v = to[k], dv = du + weight[k];
+                    if (dv < d[v]) pq.push({d[v] = dv, v});
+                }
+            }
+        } else {
+            RadixHeap pq;
+            pq.push(0, 0);
+            while (!pq.empty()) {
+                auto [du, u] = pq.pop();
+                if ((int) du != d[u]) continue; // stale entry
+                for (int k = start[u]; k < start[u + 1]; k++) {
+                    int v = to[k], dv = du + weight[k];
+                    if (dv < d[v]) pq.push(d[v] = dv, v);
+                }
+            }
+        }
+        seconds[engine] = std::chrono::duration<double>(clock::now() - t0).count();
+    }
+
+    std::cout << "VEBPriorityQueue:    " << seconds[0] << "s" << std::endl;
+    std::cout << "std::priority_queue: " << seconds[1] << "s" << std::endl;
+    std::cout << "radix heap:          " << seconds[2] << "s" << std::endl;
+    if (dist[0] != dist[1] || dist[0] != dist[2]) std::cout << "distances differ!" << std::endl;
+}
+
+// rank and select queries on n random keys: V with RANK against the pbds order-statistics
+// tree (order_of_key / find_by_order). The keys and queries are generated before any clock starts
+void check_performance_rank(int U, int n, int queries, int flags = 0) {
+    typedef std::chrono::steady_clock clock;
+
+    int bits = 0;
+    while ((1 << bits) < U) ++bits;
+
+    std::vector<int> keys(n), xs(queries), ks(queries);
+    for (int& x : keys) x = rand() % U;
+    for (int& x : xs) x = rand() % U;
+
+    V* VEB = new V(bits, flags | V::RANK);
+    ordered_set s;
+    for (int x : keys) {
+        VEB->insert(x);
+        s.insert(x);
+    }
+    for (int& k : ks) k = rand() % VEB->size;
+
+    long long ans[2] = {0, 0};
+    auto t0 = clock::now();
+    for (int x : xs) ans[0] += VEB->rank(x);
+    auto t1 = clock::now();
+    for (int k : ks) ans[0] += VEB->select(k);
+    auto t2 = clock::now();
+    for (int x : xs) ans[1] += s.order_of_key(x);
+    auto t3 = clock::now();
+    for (int k : ks) ans[1] += *s.find_by_order(k);
+    auto t4 = clock::now();
+
+    std::cout << "V rank:        " << std::chrono::duration<double>(t1 - t0).count() << "s" << std::endl;
+    std::cout << "V select:      " << std::chrono::duration<double>(t2 - t1).count() << "s" << std::endl;
+    std::cout << "order_of_key:  " << std::chrono::duration<double>(t3 - t2).count() << "s" << std::endl;
+    std::cout << "find_by_order: " << std::chrono::duration<double>(t4 - t3).count() << "s" << std::endl;
+    if (ans[0] != ans[1]) std::cout << "answers differ!" << std::endl;
+    delete VEB;
+}
+
+// same workload as check_performance_VEB, with keys drawn from the whole 64-bit range
+long long check_performance_V64(int insertions, int erases, int successors) {
+    long long ans = 0;
+
+    std::mt19937_64 rng(rand());
+    V64* VEB = new V64();
+
+    for (int i = 0; i < insertions; i++) {
+        uint64_t x = rng();
+        if (!VEB->contains(x))
+            VEB->insert(x);
+    }
+
+    for (int i = 0; i < erases; i++) {
+        VEB->erase(rng());
+    }
+
+    for (int i = 0; i < successors; i++) {
+        uint64_t y;
+        ans += VEB->successor(rng(), y) ? (long long) (y >> 32) : -1;
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    delete VEB;
+    return ans;
+}
+
+// compares building and tearing down a full (eager) tree with per-node new/delete
+// against the same tree carved out of an Arena and released in one go
+void check_performance_construction(int bits, int rounds) {
+    typedef std::chrono::steady_clock clock;
+    double build[2] = {0, 0}, teardown[2] = {0, 0};
+
+    for (int round = 0; round < rounds; round++) {
+        auto t0 = clock::now();
+        V* VEB = new V(bits);
+        auto t1 = clock::now();
+        delete VEB;
+        auto t2 = clock::now();
+        build[0] += std::chrono::duration<double>(t1 - t0).count();
+        teardown[0] += std::chrono::duration<double>(t2 - t1).count();
+
+        t0 = clock::now();
+        Arena* arena = new Arena();
+        VEB = arena->make<V>(bits, 0, arena);
+        t1 = clock::now();
+        delete arena;
+        t2 = clock::now();
+        build[1] += std::chrono::duration<double>(t1 - t0).count();
+        teardown[1] += std::chrono::duration<double>(t2 - t1).count();
+    }
+
+    std::cout << "new/delete: construct " << build[0] / rounds << "s, destroy " << teardown[0] / rounds << "s" << std::endl;
+    std::cout << "arena:      construct " << build[1] / rounds << "s, destroy " << teardown[1] / rounds << "s" << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Workload generators for the benchmark suite.
+// Rng is xoshiro256** seeded through splitmix64: a few shifts and multiplies per draw and no
+// global state, unlike rand(). Keys follow one of these distributions over [0, 2^bits):
+//   uniform     every key equally likely
+//   zipf        key of rank k drawn with probability ~ 1/k^0.99, ranks scattered over the universe
+//   clustered   16 dense ranges of 2^(bits-6) keys each (ID blocks), uniform inside a range
+//   sequential  consecutive keys from a random start (timestamps), queries scan them in order
+//   sliding     same keys, but queries hit the live window, skewed towards the newest keys
+
+struct Rng {
+    uint64_t s[4];
+
+    explicit Rng(uint64_t seed);
+
+    uint64_t next();
+    uint32_t below(uint32_t n); // uniform in [0, n)
+    double uniform(); // uniform in [0, 1)
+};
+
+Rng::Rng(uint64_t seed) {
+    for (uint64_t& x : s) { // splitmix64
+        uint64_t z = seed += 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        x = z ^ (z >> 31);
+    }
+}
+
+uint64_t Rng::next() {
+    auto rotl = [](uint64_t x, int k) { return (x << k) | (x >> (64 - k)); };
+    uint64_t result = rotl(s[1] * 5, 7) * 9, t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+uint32_t Rng::below(uint32_t n) { return (next() >> 32) * n >> 32; }
+double Rng::uniform() { return (next() >> 11) * 0x1.0p-53; }
+
+// Zipf distribution over ranks 1..n with exponent q != 1, by rejection-inversion
+// (Hormann and Derflinger): O(1) setup and about one iteration per draw, for any n
+struct Zipf {
+    double q, hx1, hn, threshold;
+
+    Zipf(double n, double q);
+
+    double h(double x) const;
+    double H(double x) const; // integral of h
+    double Hinv(double x) const;
+    long long operator()(Rng& rng) const;
+};
+
+Zipf::Zipf(double n, double q) : q(q) {
+    hx1 = H(1.5) - 1;
+    hn = H(n + 0.5);
+    threshold = 2 - Hinv(H(2.5) - h(2));
+}
+
+double Zipf::h(double x) const { return std::exp(-q * std::log(x)); }
+double Zipf::H(double x) const { return std::expm1((1 - q) * std::log(x)) / (1 - q); }
+double Zipf::Hinv(double x) const { return std::exp(std::log1p(x * (1 - q)) / (1 - q)); }
+
+long long Zipf::operator()(Rng& rng) const {
+    for (;;) {
+        double u = hn + rng.uniform() * (hx1 - hn);
+        double x = Hinv(u);
+        long long k = std::max(1LL, (long long) (x + 0.5));
+        if (k - x <= threshold || u >= H(k + 0.5) - h(k)) return k;
+    }
+}
+
+enum Distribution { UNIFORM, ZIPF, CLUSTERED, SEQUENTIAL, SLIDING, DISTRIBUTIONS };
+const char* distribution_name[DISTRIBUTIONS] = {"uniform", "zipf", "clustered", "sequential", "sliding"};
+
+// key source for the uniform, zipf and clustered distributions; every stream of one
+// workload is drawn from the same generator, so they share the hot keys / dense ranges
+struct KeyGenerator {
+    Distribution d;
+    int mask;
+    Rng& rng;
+    Zipf zipf;
+    std::vector<int> start; // first key of each dense range (clustered)
+
+    KeyGenerator(Distribution d, int bits, Rng& rng);
+    int next();
+};
+
+KeyGenerator::KeyGenerator(Distribution d, int bits, Rng& rng) : d(d), mask((1 << bits) - 1), rng(rng),
+                                                                 zipf(1 << bits, 0.99), start(16) {
+    for (int& x : start) x = rng.next() & mask;
+}
+
+int KeyGenerator::next() {
+    if (d == ZIPF) return (uint32_t) (zipf(rng) - 1) * 0x9E3779B1u & mask; // odd multiplier, a bijection
+    if (d == CLUSTERED) return (start[rng.below(start.size())] + (rng.next() & (mask >> 6))) & mask;
+    return rng.next() & mask;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Benchmark suite, in the spirit of Google Benchmark.
+// For every key distribution, universe size (bits), fill ratio and operation count, each
+// repetition draws one workload: the keys the tree is filled with (fill * 2^bits draws, so
+// repeats are possible) and one stream of ops keys per phase. Streams are generated before
+// any clock starts and every engine runs the same streams. Phases are timed separately:
+//   construct  create the tree and insert the fill keys (ns per key)
+//   successor, contains  queries on the filled tree
+//   insert, erase  keys from the distribution, present or not (for sequential and sliding:
+//                  new keys past the newest one, and the oldest keys first)
+// An engine that cannot take a universe (VEB<Bits> above TEMPLATE_BITS) gets one n/a row per
+// phase and the sweep goes on.
+// Results go to stdout as CSV, one row per repetition plus mean / median / stddev rows, with
+// the engine's peak heap growth (sampled at phase boundaries) on the repetition rows; or, with
+// --format=table, one table per workload of median throughput and peak memory per engine.
+// --engines=all runs every vEB variant next to std::set, the pbds tree, a sorted vector and a
+// flat bitset. ShardedV (one shard per thread) is given construct, successor, insert and
+// erase as batches run by its workers; contains stays key by key. V-bulk builds from the fill
+// keys with the parallel bulk load; --threads (default: hardware threads) sizes both. --counters=on adds perf
+// event counts per op (see PerfCounters) to every phase.
+
+enum { CONSTRUCT, SUCCESSOR, CONTAINS, INSERT, ERASE, PHASES };
+const char* phase_name[PHASES] = {"construct", "successor", "contains", "insert", "erase"};
+
+struct BenchmarkOptions {
+    std::vector<int> bits = {16, 20, 24};
+    std::vector<double> fill = {0.01, 0.1, 0.5};
+    std::vector<long long> ops = {1000000};
+    std::vector<std::string> engines = {"V", "V-lazy", "V-rank", "ordered_set"};
+    std::vector<int> distributions = {UNIFORM, ZIPF, CLUSTERED, SEQUENTIAL, SLIDING};
+    int repetitions = 5;
+    uint64_t seed = 1;
+    bool table = false; // a throughput / memory table per workload instead of CSV
+    bool counters = false; // perf event counts per op for every phase
+    int threads = std::max(1u, std::thread::hardware_concurrency()); // workers of V-bulk and ShardedV
+};
+
+struct Workload {
+    int bits;
+    std::vector<int> fill, ops[PHASES]; // ops[CONSTRUCT] is unused
+};
+
+Workload make_workload(Distribution d, int bits, double fill, long long ops, uint64_t seed) {
+    Rng rng(seed);
+    Workload w;
+    w.bits = bits;
+    w.fill.resize((long long) (fill * (1 << bits)));
+    for (int phase = SUCCESSOR; phase < PHASES; phase++) w.ops[phase].resize(ops);
+
+    int mask = (1 << bits) - 1;
+    if (d == SEQUENTIAL || d == SLIDING) {
+        long long n = w.fill.size(), first = rng.next() & mask, head = first + n;
+        for (long long k = 0; k < n; k++) w.fill[k] = (first + k) & mask;
+        for (long long k = 0; k < ops; k++) {
+            w.ops[INSERT][k] = (head + k) & mask;
+            w.ops[ERASE][k] = (first + k) & mask;
+            if (d == SEQUENTIAL) {
+                w.ops[SUCCESSOR][k] = w.ops[CONTAINS][k] = (first + k % std::max(n, 1LL)) & mask;
+            } else { // newest keys most often
+                w.ops[SUCCESSOR][k] = (head - 1 - rng.below(rng.below(n + 1) + 1)) & mask;
+                w.ops[CONTAINS][k] = (head - 1 - rng.below(rng.below(n + 1) + 1)) & mask;
+            }
+        }
+        return w;
+    }
+
+    KeyGenerator keys(d, bits, rng);
+    for (int& x : w.fill) x = keys.next();
+    for (int phase = SUCCESSOR; phase < PHASES; phase++)
+        for (int& x : w.ops[phase]) x = keys.next();
+    return w;
+}
+
+// the pbds tree behind the suite's engine interface
+struct OrderedSetEngine {
+    ordered_set s;
+
+    void insert(int x) { s.insert(x); }
+    void erase(int x) { s.erase(x); }
+    int successor(int x) const {
+        auto it = s.upper_bound(x);
+        return it == s.end() ? -1 : *it;
+    }
+    bool contains(int x) const { return s.find(x) != s.end(); }
+};
+
+struct StdSetEngine {
+    std::set<int> s;
+
+    void insert(int x) { s.insert(x); }
+    void erase(int x) { s.erase(x); }
+    int successor(int x) const {
+        auto it = s.upper_bound(x);
+        return it == s.end() ? -1 : *it;
+    }
+    bool contains(int x) const { return s.count(x); }
+};
+
+// a sorted std::vector searched with lower_bound / upper_bound; it is filled in one sort (see
+// fill below) and every insert / erase shifts the tail, so updates are O(n)
+struct SortedVectorEngine {
+    std::vector<int> a;
+
+    void assign(const std::vector<int>& keys) {
+        a = keys;
+        std::sort(a.begin(), a.end());
+        a.erase(std::unique(a.begin(), a.end()), a.end());
+        a.shrink_to_fit();
+    }
+    void insert(int x) {
+        auto it = std::lower_bound(a.begin(), a.end(), x);
+        if (it == a.end() || *it != x) a.insert(it, x);
+    }
+    void erase(int x) {
+        auto it = std::lower_bound(a.begin(), a.end(), x);
+        if (it != a.end() && *it == x) a.erase(it);
+    }
+    int successor(int x) const {
+        auto it = std::upper_bound(a.begin(), a.end(), x);
+        return it == a.end() ? -1 : *it;
+    }
+    bool contains(int x) const { return std::binary_search(a.begin(), a.end(), x); }
+};
+
+// one bit per key of the universe; successor scans words up from x's word
+struct BitsetEngine {
+    std::vector<uint64_t> words;
+
+    explicit BitsetEngine(int bits) : words(std::max(1, (1 << bits) >> 6)) {}
+    void insert(int x) { words[x >> 6] |= 1ULL << (x & 63); }
+    void erase(int x) { words[x >> 6] &= ~(1ULL << (x & 63)); }
+    int successor(int x) const {
+        size_t k = x >> 6;
+        uint64_t w = (x & 63) == 63 ? 0 : words[k] & (~0ULL << ((x & 63) + 1));
+        while (w == 0) {
+            if (++k == words.size()) return -1;
+            w = words[k];
+        }
+        return k << 6 | __builtin_ctzll(w);
+    }
+    bool contains(int x) const { return words[x >> 6] >> (x & 63) & 1; }
+};
+
+// for trees whose insert / erase assume the key is absent / present (FlatV, VEB<Bits>)
+template<class T>
+struct GuardedEngine {
+    T t;
+
+    template<class... Args> explicit GuardedEngine(Args... args) : t(args...) {}
+    void insert(int x) { if (!t.contains(x)) t.insert(x); }
+    void erase(int x) { if (t.contains(x)) t.erase(x); }
+    int successor(int x) const { return t.successor(x); }
+    bool contains(int x) const { return t.contains(x); }
+};
+
+struct V64Engine {
+    V64 t;
+
+    explicit V64Engine(int bits) : t(bits) {}
+    void insert(int x) { if (!t.contains(x)) t.insert(x); }
+    void erase(int x) { if (t.contains(x)) t.erase(x); }
+    int successor(int x) const {
+        uint64_t y;
+        return t.successor(x, y) ? (int) y : -1;
+    }
+    bool contains(int x) const { return t.contains(x); }
+};
+
+// a V filled by one parallel bulk load (build_from_sorted on a pool of workers), so the
+// construct phase sorts the fill keys and builds the top-level clusters on every worker
+struct BulkEngine {
+    WorkerPool pool;
+    V t;
+
+    BulkEngine(int bits, int threads) : pool(threads), t(bits) {}
+    void assign(const std::vector<int>& keys) { t.build_from_sorted(keys.data(), keys.size(), pool); }
+    void insert(int x) { t.insert(x); }
+    void erase(int x) { t.erase(x); }
+    int successor(int x) const { return t.successor(x); }
+    bool contains(int x) const { return t.contains(x); }
+};
+
+// a lazy V whose nodes come from its own arena, freed all at once with the engine
+struct ArenaEngine {
+    Arena arena;
+    V t;
+
+    explicit ArenaEngine(int bits) : t(bits, V::LAZY, &arena) {}
+    void insert(int x) { t.insert(x); }
+    void erase(int x) { t.erase(x); }
+    int successor(int x) const { return t.successor(x); }
+    bool contains(int x) const { return t.contains(x); }
+};
+
+// the keys of a phase go through these, so an engine with a batch interface (ShardedV) is
+// handed the whole stream at once instead of key by key
+template<class T>
+void insert_all(T* t, const int* keys, size_t n) { for (size_t k = 0; k < n; k++) t->insert(keys[k]); }
+void insert_all(ShardedV* t, const int* keys, size_t n) { t->insert_batch(keys, n); }
+
+template<class T>
+void erase_all(T* t, const int* keys, size_t n) { for (size_t k = 0; k < n; k++) t->erase(keys[k]); }
+void erase_all(ShardedV* t, const int* keys, size_t n) { t->erase_batch(keys, n); }
+
+template<class T>
+long long successor_sum(T* t, const int* xs, size_t n) {
+    long long sum = 0;
+    for (size_t k = 0; k < n; k++) sum += t->successor(xs[k]);
+    return sum;
+}
+long long successor_sum(ShardedV* t, const int* xs, size_t n) {
+    std::vector<int> out(n);
+    t->successor_batch(xs, out.data(), n);
+    long long sum = 0;
+    for (int y : out) sum += y;
+    return sum;
+}
+
+// construct inserts the fill keys, except for engines with a bulk assign
+template<class T>
+auto fill(T* t, const std::vector<int>& keys, int) -> decltype(t->assign(keys), void()) { t->assign(keys); }
+template<class T>
+void fill(T* t, const std::vector<int>& keys, long) { insert_all(t, keys.data(), keys.size()); }
+
+// how many keys of each insert / erase stream to run; the sorted vector only gets a prefix
+// (about 4e9 shifted keys per phase), timed per op like the rest
+template<class T>
+size_t update_limit(const T*, size_t, size_t ops) { return ops; }
+size_t update_limit(const SortedVectorEngine*, size_t n, size_t ops) {
+    return std::min<size_t>(ops, std::max<size_t>(1000, 4e9 / (n + 1)));
+}
+
+// bytes currently allocated through malloc (main arena plus mmapped chunks), -1 where
+// mallinfo2 is missing (glibc before 2.33, other C libraries)
+long long allocated_bytes() {
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 m = mallinfo2();
+    return m.uordblks + m.hblkhd;
+#else
+    return -1;
+#endif
+}
+
+// what one engine run of a workload produced
+struct EngineResult {
+    double ns[PHASES];
+    long long checksum[PHASES];
+    long long peak; // largest heap growth seen at the phase boundaries (misses transient peaks), -1 if unknown
+    double events[PHASES][PerfCounters::EVENTS]; // counter values per op, -1 if not counted
+};
+
+// runs every phase of w on a tree from make(), counting perf events around each phase if
+// perf is given; T needs insert / erase that tolerate present / absent keys, successor (-1 if
+// none) and contains
+template<class T, class Make>
+void measure(const Workload& w, Make make, PerfCounters* perf, EngineResult& r) {
+    typedef std::chrono::steady_clock clock;
+    clock::time_point t0;
+    auto begin = [&]() {
+        if (perf) perf->start();
+        t0 = clock::now();
+    };
+    auto end = [&](int phase, size_t n) {
+        r.ns[phase] = std::chrono::duration<double, std::nano>(clock::now() - t0).count() / std::max<size_t>(n, 1);
+        if (perf) perf->stop(n, r.events[phase]);
+        else std::fill(r.events[phase], r.events[phase] + PerfCounters::EVENTS, -1);
+    };
+    long long base = allocated_bytes();
+    auto sample = [&]() { if (base != -1) r.peak = std::max(r.peak, allocated_bytes() - base); };
+    r.peak = base == -1 ? -1 : 0;
+
+    begin();
+    T* t = make();
+    fill(t, w.fill, 0);
+    end(CONSTRUCT, w.fill.size());
+    r.checksum[CONSTRUCT] = w.fill.size();
+    sample();
+
+    begin();
+    long long sum = successor_sum(t, w.ops[SUCCESSOR].data(), w.ops[SUCCESSOR].size());
+    end(SUCCESSOR, w.ops[SUCCESSOR].size());
+    r.checksum[SUCCESSOR] = sum;
+
+    sum = 0;
+    begin();
+    for (int x : w.ops[CONTAINS]) sum += t->contains(x);
+    end(CONTAINS, w.ops[CONTAINS].size());
+    r.checksum[CONTAINS] = sum;
+
+    size_t n = update_limit(t, w.fill.size(), w.ops[INSERT].size());
+    begin();
+    insert_all(t, w.ops[INSERT].data(), n);
+    end(INSERT, n);
+    r.checksum[INSERT] = t->successor(0);
+    sample();
+
+    n = update_limit(t, w.fill.size(), w.ops[ERASE].size());
+    begin();
+    erase_all(t, w.ops[ERASE].data(), n);
+    end(ERASE, n);
+    r.checksum[ERASE] = t->successor(0);
+    sample();
+
+    delete t;
+}
+
+const int TEMPLATE_BITS = 26; // largest universe instantiated for the VEB<Bits> engine
+
+template<int Bits>
+void measure_template(const Workload& w, PerfCounters* perf, EngineResult& r) {
+    if constexpr (Bits > 1) {
+        if (w.bits < Bits) return measure_template<Bits - 1>(w, perf, r);
+    }
+    measure<GuardedEngine<VEB<Bits>>>(w, []() { return new GuardedEngine<VEB<Bits>>(); }, perf, r);
+}
+
+// one shard per thread (rounded down to a power of 2, at most 64 and 2^bits)
+int shards(int bits, int threads) {
+    int s = 1;
+    while (s * 2 <= threads && s < 64 && s < (1 << bits)) s *= 2;
+    return s;
+}
+
+const std::vector<std::string> all_engines = {
+    "V", "V-lazy", "V-rank", "V-bulk", "V-arena", "FlatV", "VEB<Bits>", "V64", "LockedV", "AtomicV", "SnapshotV", "ShardedV",
+    "ordered_set", "std::set", "sorted_vector", "bitset"};
+
+// whether engine can take a universe of 2^bits keys
+bool supports(const std::string& engine, int bits) {
+    return engine != "VEB<Bits>" || bits <= TEMPLATE_BITS;
+}
+
+// threads is the worker count of the parallel engines (V-bulk, ShardedV); engine must be
+// supported for w's universe, and false means an unknown engine name
+bool run_engine(const std::string& engine, const Workload& w, int threads, PerfCounters* perf, EngineResult& r) {
+    int bits = w.bits;
+    if (engine == "V") measure<V>(w, [&]() { return new V(bits); }, perf, r);
+    else if (engine == "V-lazy") measure<V>(w, [&]() { return new V(bits, V::LAZY); }, perf, r);
+    else if (engine == "V-rank") measure<V>(w, [&]() { return new V(bits, V::RANK); }, perf, r);
+    else if (engine == "V-bulk") measure<BulkEngine>(w, [&]() { return new BulkEngine(bits, threads); }, perf, r);
+    else if (engine == "V-arena") measure<ArenaEngine>(w, [&]() { return new ArenaEngine(bits); }, perf, r);
+    else if (engine == "FlatV") measure<GuardedEngine<FlatV>>(w, [&]() { return new GuardedEngine<FlatV>(bits); }, perf, r);
+    else if (engine == "VEB<Bits>") measure_template<TEMPLATE_BITS>(w, perf, r);
+    else if (engine == "V64") measure<V64Engine>(w, [&]() { return new V64Engine(bits); }, perf, r);
+    else if (engine == "LockedV") measure<LockedV>(w, [&]() { return new LockedV(bits); }, perf, r);
+    else if (engine == "AtomicV") measure<AtomicV>(w, [&]() { return new AtomicV(bits); }, perf, r);
+    else if (engine == "SnapshotV") measure<SnapshotV>(w, [&]() { return new SnapshotV(bits); }, perf, r);
+    else if (engine == "ShardedV") measure<ShardedV>(w, [&]() { return new ShardedV(bits, shards(bits, threads)); }, perf, r);
+    else if (engine == "ordered_set") measure<OrderedSetEngine>(w, []() { return new OrderedSetEngine(); }, perf, r);
+    else if (engine == "std::set") measure<StdSetEngine>(w, []() { return new StdSetEngine(); }, perf, r);
+    else if (engine == "sorted_vector") measure<SortedVectorEngine>(w, []() { return new SortedVectorEngine(); }, perf, r);
+    else if (engine == "bitset") measure<BitsetEngine>(w, [&]() { return new BitsetEngine(bits); }, perf, r);
+    else return false;
+    return true;
+}
+
+// the whole of s as a number: std::stod alone stops at the first bad character, so "1e6x"
+// would pass as 1e6
+double parse_number(const std::string& s) {
+    size_t used = 0;
+    double v = std::stod(s, &used);
+    if (used != s.size()) throw std::invalid_argument(s);
+    return v;
+}
+
+template<class T>
+std::vector<T> parse_list(const std::string& s) {
+    std::vector<T> v;
+    for (size_t k = 0, e; k <= s.size(); k = e + 1) {
+        e = std::min(s.find(',', k), s.size());
+        v.push_back((T) parse_number(s.substr(k, e - k)));
+    }
+    return v;
+}
+
+std::vector<std::string> parse_names(const std::string& s) {
+    std::vector<std::string> v;
+    for (size_t k = 0, e; k <= s.size(); k = e + 1) {
+        e = std::min(s.find(',', k), s.size());
+        v.push_back(s.substr(k, e - k));
+    }
+    return v;
+}
+
+// returns false (after printing usage) on a bad command line
+bool parse_options(int argc, char* argv[], BenchmarkOptions& opt) {
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq), value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        try {
+            if (value.empty()) throw std::invalid_argument(key);
+            if (key == "--bits") opt.bits = parse_list<int>(value);
+            else if (key == "--fill") {
+                opt.fill = parse_list<double>(value);
+                for (double f : opt.fill)
+                    if (!(f > 0)) throw std::invalid_argument(value);
+            }
+            else if (key == "--ops") {
+                opt.ops = parse_list<long long>(value);
+                for (long long n : opt.ops)
+                    if (n < 1) throw std::invalid_argument(value);
+            }
+            else if (key == "--engines") {
+                opt.engines = value == "all" ? all_engines : parse_names(value);
+                for (const std::string& name : opt.engines)
+                    if (std::find(all_engines.begin(), all_engines.end(), name) == all_engines.end())
+                        throw std::invalid_argument(name);
+            }
+            else if (key == "--distributions") {
+                opt.distributions.clear();
+                for (const std::string& name : parse_names(value)) {
+                    int d = std::find(distribution_name, distribution_name + DISTRIBUTIONS, name) - distribution_name;
+                    if (d == DISTRIBUTIONS) throw std::invalid_argument(name);
+                    opt.distributions.push_back(d);
+                }
+            }
+            else if (key == "--repetitions" && parse_number(value) >= 1) opt.repetitions = parse_number(value);
+            else if (key == "--seed") {
+                size_t used = 0;
+                opt.seed = std::stoull(value, &used);
+                if (used != value.size()) throw std::invalid_argument(value);
+            }
+            else if (key == "--threads" && parse_number(value) >= 1) opt.threads = parse_number(value);
+            else if (key == "--format" && (value == "csv" || value == "table")) opt.table = value == "table";
+            else if (key == "--counters" && (value == "on" || value == "off")) opt.counters = value == "on";
+            else throw std::invalid_argument(key);
+        } catch (const std::exception&) {
+            std::cerr << "bad option " << arg << "\n"
+                      << "usage: " << argv[0] << " [test] [--bits=16,20,24] [--fill=0.01,0.1,0.5] [--ops=1e6]"
+                      << " [--engines=V,V-lazy,V-rank,ordered_set|all]"
+                      << " [--distributions=uniform,zipf,clustered,sequential,sliding] [--repetitions=5] [--seed=1]"
+                      << " [--format=csv|table] [--counters=off|on] [--threads=" << opt.threads << "]" << std::endl;
+            return false;
+        }
+    }
+    for (int bits : opt.bits) {
+        if (bits < 1 || bits > 30) {
+            std::cerr << "bits must be in [1, 30]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+struct BenchmarkConfig {
+    int distribution, bits;
+    double fill;
+    long long ops;
+};
+
+// one CSV row; repetition is a number or mean / median / stddev, checksum, peak and the
+// counters (",value" per perf event, if counted) are empty for those
+void print_row(const std::string& engine, int phase, const BenchmarkConfig& c, const std::string& repetition,
+               double ns, const std::string& checksum, const std::string& peak, const std::string& counters) {
+    std::cout << engine << "/" << phase_name[phase] << "/dist:" << distribution_name[c.distribution]
+              << "/bits:" << c.bits << "/fill:" << c.fill << "/ops:" << c.ops
+              << (checksum.empty() ? "_" + repetition : "") << "," << engine << "," << phase_name[phase] << ","
+              << distribution_name[c.distribution] << "," << c.bits << "," << c.fill << "," << c.ops << ","
+              << repetition << "," << ns << "," << checksum << "," << peak << counters << std::endl;
+}
+
+// one line per engine: median throughput of each phase in Mops/s and the largest peak in MiB,
+// n/a for an engine that cannot take the universe
+void print_table(const std::vector<std::string>& engines, const BenchmarkConfig& c, int repetitions,
+                 const std::vector<std::vector<std::vector<double>>>& median, const std::vector<long long>& peak) {
+    char line[256];
+    std::cout << distribution_name[c.distribution] << " bits=" << c.bits << " fill=" << c.fill << " ops=" << c.ops
+              << " (median Mops/s of " << repetitions << " repetitions, peak MiB)" << std::endl;
+    snprintf(line, sizeof line, "%-14s", "engine");
+    std::cout << line;
+    for (int phase = 0; phase < PHASES; phase++) {
+        snprintf(line, sizeof line, " %10s", phase_name[phase]);
+        std::cout << line;
+    }
+    std::cout << "   peak MiB" << std::endl;
+    for (size_t e = 0; e < engines.size(); e++) {
+        snprintf(line, sizeof line, "%-14s", engines[e].c_str());
+        std::cout << line;
+        if (median[e][0].empty()) { // the engine cannot take this universe
+            for (int phase = 0; phase <= PHASES; phase++) std::cout << "        n/a";
+            std::cout << std::endl;
+            continue;
+        }
+        for (int phase = 0; phase < PHASES; phase++) {
+            snprintf(line, sizeof line, " %10.2f", 1e3 / median[e][phase][0]);
+            std::cout << line;
+        }
+        if (peak[e] == -1) snprintf(line, sizeof line, " %10s", "n/a");
+        else snprintf(line, sizeof line, " %10.1f", peak[e] / 1048576.0);
+        std::cout << line << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+// median counts per op of successor, insert and erase for every engine, "-" where not counted
+void print_counter_table(const std::vector<std::string>& engines,
+                         const std::vector<std::vector<std::vector<std::vector<double>>>>& events) {
+    char line[256];
+    snprintf(line, sizeof line, "%-24s", "perf events per op");
+    std::cout << line;
+    for (int k = 0; k < PerfCounters::EVENTS; k++) {
+        snprintf(line, sizeof line, " %13s", PerfCounters::name[k]);
+        std::cout << line;
+    }
+    std::cout << std::endl;
+    for (size_t e = 0; e < engines.size(); e++) {
+        for (int phase : {SUCCESSOR, INSERT, ERASE}) {
+            snprintf(line, sizeof line, "%-24s", (engines[e] + " " + phase_name[phase]).c_str());
+            std::cout << line;
+            for (int k = 0; k < PerfCounters::EVENTS; k++) {
+                std::vector<double> v = events[e][phase][k];
+                std::sort(v.begin(), v.end());
+                if (v.empty() || v[0] < 0) snprintf(line, sizeof line, " %13s", "-");
+                else snprintf(line, sizeof line, " %13.2f", v[v.size() / 2]);
+                std::cout << line;
+            }
+            std::cout << std::endl;
+        }
+    }
+    std::cout << std::endl;
+}
+
+int run_benchmarks(const BenchmarkOptions& opt) {
+    std::vector<BenchmarkConfig> configs;
+    for (int d : opt.distributions)
+        for (int bits : opt.bits)
+            for (double fill : opt.fill)
+                for (long long ops : opt.ops)
+                    configs.push_back({d, bits, fill, ops});
+
+    PerfCounters* perf = nullptr;
+    if (opt.counters) {
+        perf = new PerfCounters();
+        for (int k = 0; k < PerfCounters::EVENTS; k++)
+            if (perf->fd[k] == -1) std::cerr << "perf event " << PerfCounters::name[k] << " is not available" << std::endl;
+        if (perf->opened() == 0) {
+            std::cerr << "no perf events could be opened (Linux only, see /proc/sys/kernel/perf_event_paranoid), running without them" << std::endl;
+            delete perf;
+            perf = nullptr;
+        }
+    }
+    std::string blank; // the counter columns of the aggregate rows
+    if (!opt.table) {
+        std::cout << "name,engine,phase,distribution,bits,fill,ops,repetition,ns_per_op,checksum,peak_bytes";
+        for (int k = 0; perf && k < PerfCounters::EVENTS; k++) {
+            std::cout << "," << PerfCounters::name[k] << "_per_op";
+            blank += ",";
+        }
+        std::cout << std::endl;
+    }
+    for (const BenchmarkConfig& c : configs) {
+        // times[engine][phase] and events[engine][phase][event] over the repetitions, peak[engine] over all of them
+        std::vector<std::vector<std::vector<double>>> times(opt.engines.size(), std::vector<std::vector<double>>(PHASES));
+        std::vector<std::vector<std::vector<std::vector<double>>>> events(
+                opt.engines.size(), std::vector<std::vector<std::vector<double>>>(PHASES, std::vector<std::vector<double>>(PerfCounters::EVENTS)));
+        std::vector<long long> peak(opt.engines.size(), -1);
+
+        for (int rep = 0; rep < opt.repetitions; rep++) {
+            Workload w = make_workload((Distribution) c.distribution, c.bits, c.fill, c.ops, opt.seed + rep);
+            for (size_t e = 0; e < opt.engines.size(); e++) {
+                if (!supports(opt.engines[e], c.bits)) { // one n/a row per phase, no aggregates
+                    for (int phase = 0; rep == 0 && !opt.table && phase < PHASES; phase++)
+                        print_row(opt.engines[e], phase, c, "n/a", NAN, "", "", blank);
+                    continue;
+                }
+                EngineResult r;
+                if (!run_engine(opt.engines[e], w, opt.threads, perf, r)) {
+                    std::cerr << "unknown engine " << opt.engines[e] << std::endl;
+                    delete perf;
+                    return 1;
+                }
+                peak[e] = std::max(peak[e], r.peak);
+                for (int phase = 0; phase < PHASES; phase++) {
+                    times[e][phase].push_back(r.ns[phase]);
+                    std::string counters;
+                    for (int k = 0; perf && k < PerfCounters::EVENTS; k++) {
+                        events[e][phase][k].push_back(r.events[phase][k]);
+                        counters += r.events[phase][k] < 0 ? "," : "," + std::to_string(r.events[phase][k]);
+                    }
+                    if (!opt.table)
+                        print_row(opt.engines[e], phase, c, std::to_string(rep), r.ns[phase], std::to_string(r.checksum[phase]),
+                                  r.peak == -1 ? "" : std::to_string(r.peak), counters);
+                }
+            }
+        }
+
+        for (size_t e = 0; e < opt.engines.size(); e++) {
+            for (int phase = 0; phase < PHASES; phase++) {
+                std::vector<double>& t = times[e][phase];
+                if (t.empty()) continue;
+                double mean = 0, var = 0;
+                for (double x : t) mean += x / t.size();
+                for (double x : t) var += (x - mean) * (x - mean) / std::max<size_t>(t.size() - 1, 1);
+                std::sort(t.begin(), t.end());
+                double median = t.size() % 2 ? t[t.size() / 2] : (t[t.size() / 2 - 1] + t[t.size() / 2]) / 2;
+
+                if (opt.table) {
+                    t.assign(1, median);
+                    continue;
+                }
+                print_row(opt.engines[e], phase, c, "mean", mean, "", "", blank);
+                print_row(opt.engines[e], phase, c, "median", median, "", "", blank);
+                print_row(opt.engines[e], phase, c, "stddev", std::sqrt(var), "", "", blank);
+            }
+        }
+        if (opt.table) print_table(opt.engines, c, opt.repetitions, times, peak);
+        if (opt.table && perf) print_counter_table(opt.engines, events);
+    }
+    delete perf;
+    return 0;
+}
+
+// usage: ./VanEmdeBoasTree test            randomized correctness tests
+//        ./VanEmdeBoasTree [--option=...]  benchmark suite, CSV or tables on stdout (see parse_options)
+int main(int argc, char* argv[]) {
+    srand(time(nullptr));
+    if (argc > 1 && std::string(argv[1]) == "test") {
+        for (int i = 0; i < 100; i++) {
+            std::cout << "Test #" << i << std::endl;
+            Arena arena;
+            if (!check_correctness(5000, rand() % 1000) || !check_correctness(5000, rand() % 1000, V::LAZY) ||
+                !check_correctness(5000, rand() % 1000, V::LAZY, &arena) || !check_correctness_arena_churn(26, 1 + rand() % 100, 1000) ||
+                !check_correctness_arena_churn(26, 1 + rand() % 100, 1000, V::LAZY | V::RANK) ||
+                !check_correctness_flat(5000, rand() % 1000) ||
+                !check_correctness_template<13>(5000, rand() % 1000) || !check_correctness_V64(rand() % 1000, 1000) ||
+                !check_correctness_build(5000, rand() % 1000) || !check_correctness_build(5000, rand() % 1000, V::LAZY) ||
+                !check_correctness_insert_erase(5000, rand() % 1000) || !check_correctness_insert_erase(5000, rand() % 1000, V::LAZY) ||
+                !check_correctness_rank(5000, rand() % 1000) || !check_correctness_rank(5000, rand() % 1000, V::LAZY) ||
+                !check_correctness_map(5000, rand() % 1000) || !check_correctness_multiset(5000, rand() % 1000) ||
+                !check_correctness_priority_queue(5000, 1 + rand() % 1000, 10000) ||
+                !check_correctness_set_operations(5000, rand() % 1000) || !check_correctness_set_operations(5000, rand() % 1000, V::LAZY) ||
+                !check_correctness_build(5000, rand() % 1000, 0, 4) || !check_correctness_build(5000, rand() % 1000, V::LAZY, 4) ||
+                !check_correctness_build(5000, rand() % 1000, V::LAZY | V::RANK, 4) ||
+                !check_correctness_batch(5000, rand() % 1000) || !check_correctness_batch(5000, rand() % 1000, V::LAZY) ||
+                !check_correctness_pipeline(5000, rand() % 1000) || !check_correctness_pipeline(5000, rand() % 1000, V::LAZY) ||
+                !check_correctness_locked(5000, rand() % 1000, 4) || !check_correctness_atomic(5000, 8, 100000) ||
+                !check_correctness_snapshot(5000, rand() % 1000, 4) || !check_correctness_sharded(5000, rand() % 1000, 8)) {
+                std::cout << "Failed Test :(" << std::endl;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // one-off comparisons, not part of the suite
+//    std::cout << check_performance_BST(5e7, 1e7, 1e7, 1e7) << std::endl; // approx. 60 seconds on my laptop
+//    std::cout << check_performance_VEB(5e7, 1e7, 1e7, 1e7) << std::endl; // approx. 13 seconds on my laptop
+//    std::cout << check_performance_VEB(5e7, 1e7, 1e7, 1e7, 0, V::LAZY) << std::endl; // no O(U) startup, memory follows the keys
+//    std::cout << check_performance_VEB(5e7, 1e7, 1e7, 1e7, 0, V::RANK) << std::endl; // cost of keeping rank / select counts
+//    check_performance_construction(26, 5);
+//    std::cout << check_performance_FlatVEB(5e7, 1e7, 1e7, 1e7) << std::endl;
+//    std::cout << check_performance_TemplateVEB<26>(5e7, 1e7, 1e7, 1e7) << std::endl;
+//    std::cout << check_performance_BST(5e7, 1e7, 1e7, 1e7, 1e7) << std::endl; // with predecessor queries
+//    std::cout << check_performance_VEB(5e7, 1e7, 1e7, 1e7, 1e7) << std::endl;
+//    std::cout << check_performance_V64(1e6, 1e6, 1e6) << std::endl;
+//    check_performance_build(5e7, 1e7);
+//    check_performance_successor_batch(5e7, 1e7, 1e7, 4096);
+//    check_performance_pipeline(5e7, 1e7, 1e7);
+//    check_performance_concurrent(5e7, 1e7, 1e6, std::thread::hardware_concurrency());
+//    check_performance_snapshot(1 << 20, 1e5, 5000, 2);
+//    check_performance_sharded(5e7, 1e7, 16);
+//    check_performance_build_parallel(5e7, 1e7, 16, V::LAZY);
+//    check_performance_intersect(5e7, 1e7);
+//    check_performance_map(5e7, 1e7, 1e7, 1e7);
+//    check_performance_multiset(5e7, 1e7, 10);
+//    check_performance_dijkstra(1e7, 5e7, 100);
+//    check_performance_rank(5e7, 1e7, 1e7);
+
+    BenchmarkOptions opt;
+    if (!parse_options(argc, argv, opt)) return 1;
+    return run_benchmarks(opt);
 }